@@ -20,6 +20,24 @@ LOCAL_SRC_FILES := main.c \
 	checksum.c \
 	crc16.c \
 	crc8.c \
+	crc.c \
+	reactor.c \
+	timestamp.c \
+	capture.c \
+	format.c \
+	reader.c \
+	monitor.c \
+	forward.c \
+	queue.c \
+	writer.c \
+	pace.c \
+	serial.c \
+	replay.c \
+	frame.c \
+	pipeline.c \
+	stats.c \
+	histogram.c \
+	ring.c \
 	list.c \
 	misc.c
 
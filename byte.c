@@ -18,225 +18,432 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
 #ifndef __USE_ISOC99
 #define __USE_ISOC99 /* for newly introduced isblank() */
 #endif
 #include <ctype.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "byte.h"
 
 #define isBinaryDigit(digit) ((digit=='0')||(digit=='1'))
 #define bitGet(digit) (digit-'0')
 
+/* Our decoder no longer reads the input one fgetc() at a time. It reads big blocks
+ * with read() and runs the good old state machines over every character in them,
+ * picking up exactly where they left off when the next block comes in. Where the
+ * CPU allows it, runs of digits and blanks are handled 16 characters at a time. */
 enum byteStateBinary {
-	byteStateBinaryComplete=0,
-	byteStateBinaryBitsIncomplete,
-	byteStateBinaryError
+	byteStateBinaryBitsIncomplete=0
 };
-int byteBaseBinaryGet(FILE *fd) {
-	int byte;
-	int bitsRead;
-	enum byteStateBinary state;
-
-	/* No real reason to do this, but it makes the compiler happy. If this next line is not
-	 * here the compiler generates this warning below:
-	 *
-	 *   warning: ‘byte’ may be used uninitialized in this function [-Wuninitialized]
-	 *
-	 * So let's initialize byte anyway. */
-	byte=0;
-
-	for(bitsRead=0,state=byteStateBinaryBitsIncomplete;state!=byteStateBinaryComplete;) {
-		static int character;
-		switch(state) {
-			case byteStateBinaryBitsIncomplete: {
-				if(bitsRead<8) {
-					character=fgetc(fd);
-					if(isBinaryDigit(character)) {
-						byte=(byte<<1)|bitGet(character);
-						bitsRead++;
-					} else if(isblank(character)) {
-						if(bitsRead) {
-							state=byteStateBinaryComplete;
-						}
-					} else {
-						if(bitsRead) {
-							if(ungetc(character,fd)!=EOF) {
-								state=byteStateBinaryComplete;
-							} else {
-								state=byteStateBinaryError;
-							}
-						} else {
-							state=byteStateBinaryError;
-						}
-					}
-				} else {
-					state=byteStateBinaryComplete;
+
+enum byteStateHexadecimal {
+	byteStateHexadecimalNibbleFirst=0,
+	byteStateHexadecimalHexNotation,
+	byteStateHexadecimalNibbleSecond
+};
+
+/* The value of every hexadecimal digit, or -1 if it's none. */
+static signed char _nibble[256];
+static char _reversed[256];
+
+enum byteDecoderRtrn byteDecoderInitialize(struct byteDecoder *decoder,int fd,enum byteBase base,int size) {
+	int index;
+	for(index=0;index<256;index++) {
+		int bit;
+		_nibble[index]=isxdigit(index)?(isdigit(index)?index-'0':toupper(index)-'A'+0xA):-1;
+		for(_reversed[index]=0,bit=0;bit<8;bit++) {
+			_reversed[index]|=((index>>bit)&0x01)<<(7-bit);
+		}
+	}
+	decoder->buffer=(unsigned char *)malloc(size);
+	if(decoder->buffer==NULL) {
+		return(byteDecoderRtrnMemory);
+	}
+	decoder->fd=fd;
+	decoder->base=base;
+	decoder->idle=NULL;
+	decoder->watchFd=-1;
+	decoder->watch=NULL;
+	decoder->size=size;
+	decoder->start=decoder->end=0;
+	decoder->state=0;
+	decoder->byte=0;
+	decoder->bits=0;
+	return(byteDecoderRtrnOk);
+}
+
+void byteDecoderDestroy(struct byteDecoder *decoder) {
+	if(decoder->buffer!=NULL) {
+		free(decoder->buffer);
+		decoder->buffer=NULL;
+	}
+}
+
+/* Add a decoded byte to the line. Returns non zero if the line is done because
+ * we have reached the limit of bytes we are allowed to take. */
+static int byteLineAdd(struct byteLine *line,int byte,int limit) {
+	if(line->length<line->size) {
+		line->data[line->length++]=byte;
+	} else {
+		line->overflow++;
+	}
+	return((limit>0)&&((line->length+line->overflow)>=limit));
+}
+
+/* The character given can not be part of a byte. Let's see what it tells us. */
+static int byteError(struct byteLine *line,int character) {
+	if(character=='\n') {
+		return(1);
+	}
+	line->unknown++;
+	return(0);
+}
+
+#if defined(__SSE2__)
+/* Return a mask with a bit set for every blank in the 16 characters given. */
+static unsigned int byteBlankMask(__m128i characters) {
+	return(_mm_movemask_epi8(_mm_or_si128(
+		_mm_cmpeq_epi8(characters,_mm_set1_epi8(' ')),
+		_mm_cmpeq_epi8(characters,_mm_set1_epi8('\t'))
+	)));
+}
+
+/* Skip a run of blanks. Returns the amount of characters skipped. */
+static int byteBlankSkip(__m128i characters) {
+	unsigned int mask;
+	mask=byteBlankMask(characters);
+	return(mask==0xFFFF?16:__builtin_ctz(~mask));
+}
+
+/* Take a look at 16 characters at once. Returns a mask with a bit set for every
+ * hexadecimal digit and fills in the value of every one of those digits. */
+static unsigned int byteBaseHexadecimalClassify(__m128i characters,__m128i *value) {
+	__m128i digit,letter,lower;
+	/* Signed compares, so anything above 127 is nicely out of range. */
+	digit=_mm_and_si128(
+		_mm_cmpgt_epi8(characters,_mm_set1_epi8('0'-1)),
+		_mm_cmplt_epi8(characters,_mm_set1_epi8('9'+1))
+	);
+	lower=_mm_or_si128(characters,_mm_set1_epi8(0x20));
+	letter=_mm_and_si128(
+		_mm_cmpgt_epi8(lower,_mm_set1_epi8('a'-1)),
+		_mm_cmplt_epi8(lower,_mm_set1_epi8('f'+1))
+	);
+	*value=_mm_or_si128(
+		_mm_and_si128(digit,_mm_sub_epi8(characters,_mm_set1_epi8('0'))),
+		_mm_andnot_si128(digit,_mm_sub_epi8(lower,_mm_set1_epi8('a'-0xA)))
+	);
+	return(_mm_movemask_epi8(_mm_or_si128(digit,letter)));
+}
+
+/* Decode 16 hexadecimal digits into 8 bytes. */
+static void byteBaseHexadecimalPack(__m128i value,unsigned char *bytes) {
+	__m128i pairs;
+	/* Every 16 bit lane holds the first nibble in its low and the second nibble
+	 * in its high byte. Put them together and pack the lot. */
+	pairs=_mm_or_si128(
+		_mm_slli_epi16(_mm_and_si128(value,_mm_set1_epi16(0x00FF)),4),
+		_mm_srli_epi16(value,8)
+	);
+	_mm_storel_epi64((__m128i *)bytes,_mm_packus_epi16(pairs,pairs));
+}
+
+/* Combine every digit with the one following it, wherever they are. */
+static void byteBaseHexadecimalCombine(__m128i value,unsigned char *bytes) {
+	_mm_storeu_si128((__m128i *)bytes,_mm_or_si128(
+		_mm_and_si128(_mm_slli_epi16(value,4),_mm_set1_epi8(0xF0)),
+		_mm_srli_si128(value,1)
+	));
+}
+
+/* Decode 16 binary digits into 2 bytes. Returns zero if the 16 characters aren't
+ * all binary digits. */
+static int byteBaseBinaryBlock(__m128i characters,unsigned char *bytes) {
+	unsigned int zeros,ones;
+	zeros=_mm_movemask_epi8(_mm_cmpeq_epi8(characters,_mm_set1_epi8('0')));
+	ones=_mm_movemask_epi8(_mm_cmpeq_epi8(characters,_mm_set1_epi8('1')));
+	if((zeros|ones)!=0xFFFF) {
+		return(0);
+	}
+	/* The first character is the most significant bit, but the lowest bit in the mask. */
+	bytes[0]=_reversed[ones&0xFF];
+	bytes[1]=_reversed[ones>>8];
+	return(1);
+}
+#endif
+
+/* Run the binary state machine over the characters in our buffer. Returns non zero
+ * when the line is done. */
+static int byteBaseBinaryScan(struct byteDecoder *decoder,struct byteLine *line,int limit) {
+	int character;
+	while(decoder->start<decoder->end) {
+#if defined(__SSE2__)
+		if((decoder->bits==0)&&((decoder->end-decoder->start)>=16)) {
+			__m128i characters;
+			unsigned char bytes[2];
+			int skip;
+			characters=_mm_loadu_si128((__m128i *)(decoder->buffer+decoder->start));
+			if((skip=byteBlankSkip(characters))>0) {
+				decoder->start+=skip;
+				continue;
+			}
+			if(((limit<=0)||((limit-line->length-line->overflow)>2))&&byteBaseBinaryBlock(characters,bytes)) {
+				byteLineAdd(line,bytes[0],limit);
+				byteLineAdd(line,bytes[1],limit);
+				decoder->start+=16;
+				continue;
+			}
+		}
+#endif
+		character=decoder->buffer[decoder->start++];
+		if(isBinaryDigit(character)) {
+			decoder->byte=(decoder->byte<<1)|bitGet(character);
+			if(++decoder->bits==8) {
+				decoder->bits=0;
+				if(byteLineAdd(line,decoder->byte,limit)) {
+					return(1);
 				}
-				break;
 			}
-			case byteStateBinaryError: {
-				switch(character) {
-					case EOF: {
-						byte=byteRtrnEOF;
-						break;
-					}
-					case '\n': {
-						byte=byteRtrnEOL;
-						break;
-					}
-					default: {
-						byte=byteRtrnUnknown;
-						break;
-					}
+		} else if(isblank(character)) {
+			if(decoder->bits) {
+				decoder->bits=0;
+				if(byteLineAdd(line,decoder->byte,limit)) {
+					return(1);
 				}
-				state=byteStateBinaryComplete;
-				break;
 			}
-			case byteStateBinaryComplete: {
-				/* Do nothing, since it's impossible to reach this stage. Just
-				 * make the compiler happy. */
-				break;
+		} else {
+			if(decoder->bits) {
+				/* This character ends our byte, but we still have to take a good look
+				 * at it. So put it back where it came from. */
+				decoder->bits=0;
+				decoder->start--;
+				if(byteLineAdd(line,decoder->byte,limit)) {
+					return(1);
+				}
+			} else if(byteError(line,character)) {
+				return(1);
 			}
 		}
+		if(decoder->bits==0) {
+			decoder->byte=0;
+		}
 	}
-	return(byte);
+	return(0);
 }
 
-/* Convert an ASCII character into a binary form. */
-static char nibbleGet(char c) {
-	return(isdigit(c)?c-'0':toupper(c)-'A'+0xA);
-}
-
-enum byteStateHexadecimal {
-	byteStateHexadecimalComplete=0,
-	byteStateHexadecimalNibbleFirst,
-	byteStateHexadecimalHexNotation,
-	byteStateHexadecimalNibbleSecond,
-	byteStateHexadecimalError
-};
-int byteBaseHexadecimalGet(FILE *fd) {
-	int byte;
-	enum byteStateHexadecimal state;
-	/* No real reason to do this, but it makes the compiler happy. If this next line is not
-	 * here the compiler generates this warning below:
-	 *
-	 *   warning: ‘byte’ may be used uninitialized in this function [-Wuninitialized]
-	 *
-	 * So let's initialize byte anyway. */
-	byte=0;
-
-	for(state=byteStateHexadecimalNibbleFirst;state!=byteStateHexadecimalComplete;) {
-		static int character;
-		switch(state) {
+/* Run the hexadecimal state machine over the characters in our buffer. Returns non
+ * zero when the line is done. */
+static int byteBaseHexadecimalScan(struct byteDecoder *decoder,struct byteLine *line,int limit) {
+	int character;
+	while(decoder->start<decoder->end) {
+#if defined(__SSE2__)
+		if((decoder->state==byteStateHexadecimalNibbleFirst)&&((decoder->end-decoder->start)>=16)) {
+			__m128i characters,value;
+			unsigned int hexadecimal,blank;
+			unsigned char bytes[16];
+			int index;
+			characters=_mm_loadu_si128((__m128i *)(decoder->buffer+decoder->start));
+			hexadecimal=byteBaseHexadecimalClassify(characters,&value);
+			if((hexadecimal==0xFFFF)&&((limit<=0)||((limit-line->length-line->overflow)>8))) {
+				byteBaseHexadecimalPack(value,bytes);
+				for(index=0;index<8;index++) {
+					byteLineAdd(line,bytes[index],limit);
+				}
+				decoder->start+=16;
+				continue;
+			}
+			/* Not a plain run of digits, but most likely something like "DE AD BE EF".
+			 * Walk along the pairs and blanks for as long as there is nothing else. */
+			blank=byteBlankMask(characters);
+			byteBaseHexadecimalCombine(value,bytes);
+			for(index=0;index<15;) {
+				if(blank&(1<<index)) {
+					index++;
+				} else if(((hexadecimal>>index)&0x03)==0x03) {
+					index+=2;
+					if(byteLineAdd(line,bytes[index-2],limit)) {
+						decoder->start+=index;
+						return(1);
+					}
+				} else {
+					break;
+				}
+			}
+			if(index>0) {
+				decoder->start+=index;
+				continue;
+			}
+		}
+#endif
+		character=decoder->buffer[decoder->start++];
+		switch(decoder->state) {
 			case byteStateHexadecimalNibbleFirst: {
-				character=fgetc(fd);
-				if(isxdigit(character)) {
-					byte=nibbleGet(character);
+				if(_nibble[character]>=0) {
+					decoder->byte=_nibble[character];
 					if(character=='0') {
-						state=byteStateHexadecimalHexNotation;
+						decoder->state=byteStateHexadecimalHexNotation;
 					} else {
-						state=byteStateHexadecimalNibbleSecond;
+						decoder->state=byteStateHexadecimalNibbleSecond;
 					}
 				} else if(!isblank(character)) {
-					state=byteStateHexadecimalError;
+					if(byteError(line,character)) {
+						return(1);
+					}
 				}
 				break;
 			}
 			case byteStateHexadecimalHexNotation: {
-				character=fgetc(fd);
 				if(tolower(character)=='x') {
-					state=byteStateHexadecimalNibbleFirst;
+					decoder->state=byteStateHexadecimalNibbleFirst;
 				} else {
-					if(ungetc(character,fd)!=EOF) {
-						state=byteStateHexadecimalNibbleSecond;
-					} else {
-						state=byteStateHexadecimalError;
-					}
+					/* Not the 0x notation, so this must be the second nibble. Take
+					 * another look at it in that light. */
+					decoder->start--;
+					decoder->state=byteStateHexadecimalNibbleSecond;
 				}
 				break;
 			}
 			case byteStateHexadecimalNibbleSecond: {
-				character=fgetc(fd);
-				if(isxdigit(character)) {
-					byte=(byte<<4)+nibbleGet(character);
-					state=byteStateHexadecimalComplete;
-				} else {
-					state=byteStateHexadecimalError;
-				}
-				break;
-			}
-			case byteStateHexadecimalError: {
-				switch(character) {
-					case EOF: {
-						byte=byteRtrnEOF;
-						break;
-					}
-					case '\n': {
-						byte=byteRtrnEOL;
-						break;
-					}
-					default: {
-						byte=byteRtrnUnknown;
-						break;
+				decoder->state=byteStateHexadecimalNibbleFirst;
+				if(_nibble[character]>=0) {
+					if(byteLineAdd(line,(decoder->byte<<4)+_nibble[character],limit)) {
+						return(1);
 					}
+				} else if(byteError(line,character)) {
+					return(1);
 				}
-				state=byteStateHexadecimalComplete;
 				break;
 			}
-			case byteStateHexadecimalComplete: {
-				/* Do nothing, since it's impossible to reach this stage. Just
-				 * make the compiler happy. */
-				break;
+		}
+	}
+	return(0);
+}
+
+/* Wait for our input to become readable, handing whatever happens to the
+ * file descriptor we watch to its call-back meanwhile. Any trouble with our
+ * input is left for the read that follows. */
+static void byteWait(struct byteDecoder *decoder) {
+	struct pollfd pollFds[2];
+	pollFds[0].fd=decoder->fd;
+	pollFds[0].events=POLLIN;
+	pollFds[1].fd=decoder->watchFd;
+	pollFds[1].events=POLLIN;
+	for(;;) {
+		if(poll(pollFds,2,-1)<0) {
+			if(errno==EINTR) {
+				continue;
+			}
+			return;
+		}
+		if(pollFds[1].revents&POLLIN) {
+			decoder->watch(NULL);
+		}
+		if(pollFds[0].revents!=0) {
+			return;
+		}
+	}
+}
+
+/* Get the next line of bytes from the input. Invalid characters and bytes that
+ * do not fit in the line are counted, so the caller can complain about them. If
+ * a limit is given, the line ends as soon as that many bytes are read. Returns
+ * byteRtrnEOL for a complete line and byteRtrnEOF once the input is exhausted,
+ * in which case an incomplete last line is discarded. */
+enum byteRtrn byteLineGet(struct byteDecoder *decoder,struct byteLine *line,int limit) {
+	int done;
+	line->length=0;
+	line->overflow=0;
+	line->unknown=0;
+	for(done=0;!done;) {
+		if(decoder->start==decoder->end) {
+			ssize_t bytesRead;
+			if(decoder->idle!=NULL) {
+				decoder->idle();
+			}
+			if(decoder->watch!=NULL) {
+				byteWait(decoder);
 			}
+			do {
+				bytesRead=read(decoder->fd,decoder->buffer,decoder->size);
+			} while((bytesRead==-1)&&(errno==EINTR));
+			if(bytesRead<=0) {
+				return(byteRtrnEOF);
+			}
+			decoder->start=0;
+			decoder->end=bytesRead;
+		}
+		switch(decoder->base) {
+#define BASE(base,name,width) \
+			case name: { \
+				done=name##Scan(decoder,line,limit); \
+				break; \
+			}
+			BASES
+#undef BASE
 		}
 	}
-	return(byte);
+	return(byteRtrnEOL);
 }
 
-int byteGet(FILE *fd,enum byteBase base) {
+/* Our tables with the printed form of every possible byte value. They are
+ * created once by byteTableCreate(), so printing a byte does not cost any
+ * more than a lookup. Take notice these are not zero terminated. */
+static char byteBaseBinaryTable[256][8];
+static char byteBaseHexadecimalTable[256][2];
+
+static void byteBaseBinaryTableCreate(void) {
+	int byte,bit;
+	for(byte=0;byte<256;byte++) {
+		for(bit=0;bit<8;bit++) {
+			byteBaseBinaryTable[byte][bit]='0'+((byte>>(7-bit))&0x01);
+		}
+	}
+}
+
+static void byteBaseHexadecimalTableCreate(void) {
+	static const char digits[]="0123456789ABCDEF";
 	int byte;
-	/* No real reason to do this, but it makes the compiler happy. If this next line is not
-	 * here the compiler generates this warning below:
-	 *
-	 *   warning: ‘byte’ may be used uninitialized in this function [-Wuninitialized]
-	 *
-	 * So let's initialize byte anyway. */
-	byte=0;
+	for(byte=0;byte<256;byte++) {
+		byteBaseHexadecimalTable[byte][0]=digits[byte>>4];
+		byteBaseHexadecimalTable[byte][1]=digits[byte&0x0F];
+	}
+}
 
+void byteTableCreate(void) {
+#define BASE(base,name,width) name##TableCreate();
+	BASES
+#undef BASE
+}
+
+/* Return the printed form of the given byte in the given base. It's exactly
+ * byteWidth() characters long and not zero terminated. */
+const char *byteString(enum byteBase base,unsigned char byte) {
 	switch(base) {
 #define BASE(base,name,width) \
 		case name: { \
-			byte=name##Get(fd); \
-			break; \
+			return(name##Table[byte]); \
 		}
 		BASES
 #undef BASE
 	}
-	return(byte);
-}
-
-static void byteBaseBinaryPut(FILE *fd,unsigned char byte) {
-	char bits[(sizeof(byte)*8)+1];
-	char *p;
-	for(*(p=bits+sizeof(bits)-1)='\0';p--!=bits;byte>>=1) {
-		*p='0'+(byte&0x01);
-	}
-	fprintf(fd,"%s",bits);
-}
-
-static void byteBaseHexadecimalPut(FILE *fd, unsigned char byte) {
-	fprintf(fd,"%02X",byte);
+	return(NULL);
 }
 
-void bytePut(FILE *fd,enum byteBase base,unsigned char byte) {
+int byteWidth(enum byteBase base) {
 	switch(base) {
 #define BASE(base,name,width) \
 		case name: { \
-			name##Put(fd,byte); \
-			break; \
+			return(width); \
 		}
 		BASES
 #undef BASE
 	}
+	return(0);
 }
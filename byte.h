@@ -38,7 +38,47 @@ enum byteBase {
 #undef BASE
 };
 
-extern int byteGet(FILE *,enum byteBase);
-extern void bytePut(FILE *,enum byteBase,unsigned char);
+/* Our input decoder. It reads the input in big blocks and keeps the state of
+ * the parser, so a byte may be split over two blocks. */
+struct byteDecoder {
+	int fd;
+	enum byteBase base;
+	/* If given, called right before we wait for more input. */
+	void (*idle)(void);
+	/* If given, another file descriptor to keep an eye on while we wait for
+	 * more input. The call-back is called every time it becomes readable. */
+	int watchFd;
+	void (*watch)(void *);
+	unsigned char *buffer;
+	int size;
+	int start;
+	int end;
+	int state;
+	int byte;
+	int bits;
+};
+
+/* One line of decoded bytes. The size is the room available for the bytes, the
+ * length the amount of bytes actually stored. Bytes that did not fit are counted
+ * in overflow and every invalid character on the line is counted in unknown. */
+struct byteLine {
+	unsigned char *data;
+	int size;
+	int length;
+	int overflow;
+	int unknown;
+};
+
+enum byteDecoderRtrn {
+	byteDecoderRtrnOk=0,
+	byteDecoderRtrnMemory
+};
+
+extern enum byteDecoderRtrn byteDecoderInitialize(struct byteDecoder *,int,enum byteBase,int);
+extern enum byteRtrn byteLineGet(struct byteDecoder *,struct byteLine *,int);
+extern void byteDecoderDestroy(struct byteDecoder *);
+extern void byteTableCreate(void);
+extern const char *byteString(enum byteBase,unsigned char);
+extern int byteWidth(enum byteBase);
 
 #endif
@@ -0,0 +1,218 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "jpnevulator.h"
+#include "options.h"
+#include "interface.h"
+#include "tty.h"
+#include "capture.h"
+
+/* The state of our capture, either the one we write or the one we read. The
+ * id of an interface in the capture file is its id in our table of interfaces,
+ * counted from the first one of the capture. */
+static struct {
+	FILE *file;
+	int interfacesFirst;
+	int interfacesCount;
+	unsigned char *buffer;
+	size_t bufferSize;
+} _capture={NULL,0,0,NULL,0};
+
+/* Start a capture on the given output. Every interface known to us right now is
+ * written in the header of the capture, so make sure they are all there. */
+enum captureRtrn captureInitialize(FILE *output) {
+	struct captureHeader header;
+	int id;
+	_capture.file=output;
+	_capture.interfacesFirst=0;
+	_capture.interfacesCount=interfaceCount();
+	memset(&header,0,sizeof(header));
+	memcpy(header.magic,CAPTURE_MAGIC,sizeof(header.magic));
+	header.version=CAPTURE_VERSION;
+	header.byteOrder=CAPTURE_BYTE_ORDER;
+	header.interfaces=interfaceCount();
+	if(fwrite(&header,sizeof(header),1,output)!=1) {
+		return(captureRtrnWrite);
+	}
+	for(id=0;id<interfaceCount();id++) {
+		struct captureInterface description;
+		struct interface *interface;
+		interface=interfaceGet(id);
+		description.nameLength=strlen(interfaceName(interface));
+		description.aliasLength=strlen(interfaceAlias(interface));
+		if(
+			(fwrite(&description,sizeof(description),1,output)!=1)||
+			(fwrite(interfaceName(interface),1,description.nameLength,output)!=description.nameLength)||
+			(fwrite(interfaceAlias(interface),1,description.aliasLength,output)!=description.aliasLength)
+		) {
+			return(captureRtrnWrite);
+		}
+	}
+	return(captureRtrnOk);
+}
+
+static void captureRecordWrite(struct interface *interface,struct timestamp *time,enum captureType type,void *data,ssize_t size) {
+	struct captureRecord record;
+	record.size=size;
+	record.interface=interface->id-_capture.interfacesFirst;
+	record.type=type;
+	record.reserved=0;
+	record.monotonicSec=time->monotonic.tv_sec;
+	record.monotonicNsec=time->monotonic.tv_nsec;
+	record.realtimeSec=time->realtime.tv_sec;
+	record.realtimeNsec=time->realtime.tv_nsec;
+	if((fwrite(&record,sizeof(record),1,_capture.file)!=1)||(fwrite(data,1,size,_capture.file)!=size)) {
+		fprintf(stderr,"%s: %s: write of %ld bytes to the capture failed.\n",PROGRAM_NAME,interfacePrint(interface),(long)size);
+	}
+}
+
+/* Capture the bytes read from the given interface at the given time. */
+void captureData(struct interface *interface,struct timestamp *time,unsigned char *data,ssize_t size) {
+	captureRecordWrite(interface,time,captureTypeData,data,size);
+}
+
+/* Capture a change of the modem control bits of the given interface. */
+void captureControl(struct interface *interface,struct timestamp *time,int control) {
+	int32_t bits;
+	bits=control;
+	captureRecordWrite(interface,time,captureTypeControl,&bits,sizeof(bits));
+}
+
+/* The interfaces of a capture we read are not really there. Their file descriptor
+ * points to /dev/null, just to keep everybody happy. The only thing that's left of
+ * them are the modem control bits written in the capture. Only a tty has got any,
+ * so that's what we display. */
+static int captureInterfaceOpen(char **name) {
+	return(open("/dev/null",O_RDWR));
+}
+
+static int captureInterfaceControlGet(int fd,char *name) {
+	return(0);
+}
+
+static void captureInterfaceClose(int fd) {
+	close(fd);
+}
+
+/* Open a capture for reading, check the header and add all the interfaces the
+ * capture knows about to our list of interfaces. */
+enum captureRtrn captureOpen(FILE *input) {
+	struct captureHeader header;
+	uint32_t index;
+	_capture.file=input;
+	if(fread(&header,sizeof(header),1,input)!=1) {
+		return(captureRtrnFormat);
+	}
+	if(
+		(memcmp(header.magic,CAPTURE_MAGIC,sizeof(header.magic))!=0)||
+		(header.version!=CAPTURE_VERSION)||
+		(header.byteOrder!=CAPTURE_BYTE_ORDER)
+	) {
+		return(captureRtrnFormat);
+	}
+	_capture.interfacesFirst=interfaceCount();
+	_capture.interfacesCount=0;
+	for(index=0;index<header.interfaces;index++) {
+		struct captureInterface description;
+		char *name;
+		size_t separatorLength;
+		if(fread(&description,sizeof(description),1,input)!=1) {
+			return(captureRtrnFormat);
+		}
+		/* Glue the name and alias back together, interfaceAdd() will split them
+		 * again for us. */
+		separatorLength=strlen(_jpnevulatorOptions.aliasSeparator);
+		name=(char *)malloc(description.nameLength+separatorLength+description.aliasLength+1);
+		if(name==NULL) {
+			return(captureRtrnMemory);
+		}
+		if(fread(name,1,description.nameLength,input)!=description.nameLength) {
+			free(name);
+			return(captureRtrnFormat);
+		}
+		name[description.nameLength]='\0';
+		if(description.aliasLength>0) {
+			strcpy(&(name[description.nameLength]),_jpnevulatorOptions.aliasSeparator);
+			if(fread(&(name[description.nameLength+separatorLength]),1,description.aliasLength,input)!=description.aliasLength) {
+				free(name);
+				return(captureRtrnFormat);
+			}
+			name[description.nameLength+separatorLength+description.aliasLength]='\0';
+		}
+		if(interfaceAdd(name,captureInterfaceOpen,captureInterfaceControlGet,ttyControlWrite,captureInterfaceClose)!=interfaceRtrnOk) {
+			free(name);
+			return(captureRtrnInterface);
+		}
+		free(name);
+		_capture.interfacesCount++;
+	}
+	return(captureRtrnOk);
+}
+
+/* Read the next record of the capture. The data stays ours and is only valid up
+ * until the next call. */
+enum captureRtrn captureRead(struct interface **interface,struct timestamp *time,enum captureType *type,unsigned char **data,ssize_t *size) {
+	struct captureRecord record;
+	size_t n;
+	/* Only a capture that ends right between two records ends well. Whatever
+	 * is cut short in the middle of a record is damaged. */
+	if((n=fread(&record,1,sizeof(record),_capture.file))!=sizeof(record)) {
+		return(n==0?captureRtrnEOF:captureRtrnFormat);
+	}
+	if(record.interface>=_capture.interfacesCount) {
+		return(captureRtrnFormat);
+	}
+	if(record.size>_capture.bufferSize) {
+		unsigned char *buffer;
+		if((buffer=(unsigned char *)realloc(_capture.buffer,record.size))==NULL) {
+			return(captureRtrnMemory);
+		}
+		_capture.buffer=buffer;
+		_capture.bufferSize=record.size;
+	}
+	if(fread(_capture.buffer,1,record.size,_capture.file)!=record.size) {
+		return(captureRtrnFormat);
+	}
+	*interface=interfaceGet(_capture.interfacesFirst+record.interface);
+	time->monotonic.tv_sec=record.monotonicSec;
+	time->monotonic.tv_nsec=record.monotonicNsec;
+	time->realtime.tv_sec=record.realtimeSec;
+	time->realtime.tv_nsec=record.realtimeNsec;
+	*type=record.type;
+	*data=_capture.buffer;
+	*size=record.size;
+	return(captureRtrnOk);
+}
+
+void captureDestroy(void) {
+	if(_capture.buffer!=NULL) {
+		free(_capture.buffer);
+		_capture.buffer=NULL;
+	}
+	_capture.bufferSize=0;
+	_capture.interfacesFirst=0;
+	_capture.interfacesCount=0;
+	_capture.file=NULL;
+}
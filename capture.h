@@ -0,0 +1,86 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __CAPTURE_H
+#define __CAPTURE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "interface.h"
+#include "timestamp.h"
+
+/* Our binary capture file starts with a header, followed by a description
+ * of every interface and then the records, one after the other. Everything
+ * is written in the byte order of the machine that did the capture. */
+#define CAPTURE_MAGIC "JPNEVCAP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_BYTE_ORDER 0x01020304
+
+struct captureHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t interfaces;
+	uint32_t reserved;
+};
+
+/* Every interface is described by the length of its name and alias,
+ * followed by the name and alias themselves, without a terminating NUL. */
+struct captureInterface {
+	uint32_t nameLength;
+	uint32_t aliasLength;
+};
+
+enum captureType {
+	captureTypeData=0,
+	captureTypeControl
+};
+
+/* Every record is followed by size bytes. These are the bytes read for a
+ * data record and the new modem control bits (an int32_t) for a control
+ * record. */
+struct captureRecord {
+	uint32_t size;
+	uint16_t interface;
+	uint8_t type;
+	uint8_t reserved;
+	int64_t monotonicSec;
+	int64_t realtimeSec;
+	uint32_t monotonicNsec;
+	uint32_t realtimeNsec;
+};
+
+enum captureRtrn {
+	captureRtrnOk=0,
+	captureRtrnMemory,
+	captureRtrnWrite,
+	captureRtrnFormat,
+	captureRtrnInterface,
+	captureRtrnEOF
+};
+
+extern enum captureRtrn captureInitialize(FILE *);
+extern void captureData(struct interface *,struct timestamp *,unsigned char *,ssize_t);
+extern void captureControl(struct interface *,struct timestamp *,int);
+extern enum captureRtrn captureOpen(FILE *);
+extern enum captureRtrn captureRead(struct interface **,struct timestamp *,enum captureType *,unsigned char **,ssize_t *);
+extern void captureDestroy(void);
+
+#endif
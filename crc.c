@@ -0,0 +1,268 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+
+#include "crc.h"
+
+/* Our catalogue of well known crcs. Names and parameters are the ones you
+ * find in Greg Cook's catalogue of parametrised CRC algorithms. The byte
+ * order is the one these crcs are usually sent on the line with. */
+static const struct crcModel {
+	const char *name;
+	int width;
+	uint64_t poly;
+	uint64_t init;
+	bool_t refin;
+	bool_t refout;
+	uint64_t xorout;
+	enum crcOrder order;
+} crcCatalogue[]={
+	{"CRC-8",8,0x07,0x00,boolFalse,boolFalse,0x00,crcOrderBig},
+	{"CRC-8/MAXIM",8,0x31,0x00,boolTrue,boolTrue,0x00,crcOrderLittle},
+	{"CRC-8/ROHC",8,0x07,0xFF,boolTrue,boolTrue,0x00,crcOrderLittle},
+	{"CRC-16/ARC",16,0x8005,0x0000,boolTrue,boolTrue,0x0000,crcOrderLittle},
+	{"CRC-16/MODBUS",16,0x8005,0xFFFF,boolTrue,boolTrue,0x0000,crcOrderLittle},
+	{"CRC-16/USB",16,0x8005,0xFFFF,boolTrue,boolTrue,0xFFFF,crcOrderLittle},
+	{"CRC-16/CCITT-FALSE",16,0x1021,0xFFFF,boolFalse,boolFalse,0x0000,crcOrderBig},
+	{"CRC-16/XMODEM",16,0x1021,0x0000,boolFalse,boolFalse,0x0000,crcOrderBig},
+	{"CRC-16/KERMIT",16,0x1021,0x0000,boolTrue,boolTrue,0x0000,crcOrderLittle},
+	{"CRC-16/X-25",16,0x1021,0xFFFF,boolTrue,boolTrue,0xFFFF,crcOrderLittle},
+	{"CRC-16/DNP",16,0x3D65,0x0000,boolTrue,boolTrue,0xFFFF,crcOrderLittle},
+	{"CRC-32",32,0x04C11DB7,0xFFFFFFFF,boolTrue,boolTrue,0xFFFFFFFF,crcOrderLittle},
+	{"CRC-32C",32,0x1EDC6F41,0xFFFFFFFF,boolTrue,boolTrue,0xFFFFFFFF,crcOrderLittle},
+	{"CRC-32/MPEG-2",32,0x04C11DB7,0xFFFFFFFF,boolFalse,boolFalse,0x00000000,crcOrderBig},
+	{"CRC-64/XZ",64,0x42F0E1EBA9EA3693ULL,0xFFFFFFFFFFFFFFFFULL,boolTrue,boolTrue,0xFFFFFFFFFFFFFFFFULL,crcOrderLittle},
+	{"CRC-64/ECMA-182",64,0x42F0E1EBA9EA3693ULL,0x0000000000000000ULL,boolFalse,boolFalse,0x0000000000000000ULL,crcOrderBig},
+	{NULL,0,0,0,boolFalse,boolFalse,0,crcOrderLittle}
+};
+
+static uint64_t crcReflect(uint64_t value,int width) {
+	uint64_t reflected;
+	int bit;
+	for(reflected=0,bit=0;bit<width;bit++) {
+		reflected=(reflected<<1)|((value>>bit)&1);
+	}
+	return(reflected);
+}
+
+static const struct crcModel *crcCatalogueFind(const char *name) {
+	const struct crcModel *model;
+	for(model=crcCatalogue;model->name!=NULL;model++) {
+		if(strcasecmp(model->name,name)==0) {
+			return(model);
+		}
+	}
+	return(NULL);
+}
+
+static int crcBoolParse(char *value,bool_t *result) {
+	if((strcasecmp(value,"true")==0)||(strcasecmp(value,"yes")==0)||(strcmp(value,"1")==0)) {
+		boolSet(*result);
+	} else if((strcasecmp(value,"false")==0)||(strcasecmp(value,"no")==0)||(strcmp(value,"0")==0)) {
+		boolReset(*result);
+	} else {
+		return(-1);
+	}
+	return(0);
+}
+
+static int crcValueParse(char *value,uint64_t *result) {
+	char *end;
+	*result=strtoull(value,&end,16);
+	if((*value=='\0')||(*end!='\0')) {
+		return(-1);
+	}
+	return(0);
+}
+
+/* Parse a crc specification. This is either the name of a crc in our
+ * catalogue or a comma separated list of key=value pairs. The keys are
+ * name, width, poly, init, refin, refout, xorout and order. A name
+ * loads the catalogue entry, any other key overrides a single parameter.
+ * This way "CRC-16/MODBUS,order=big" is as good a specification as
+ * "width=16,poly=8005,init=FFFF,refin=true,refout=true". All values are
+ * hexadecimal, like our other polynomials. */
+enum crcRtrn crcParse(struct crc *crc,const char *specification) {
+	const struct crcModel *model;
+	char *copy,*token,*save;
+	enum crcRtrn rtrn;
+
+	/* Start out with an empty custom crc. */
+	memset(crc,0,sizeof(*crc));
+	crc->name="custom";
+	crc->width=16;
+	crc->order=crcOrderLittle;
+
+	if((copy=strdup(specification))==NULL) {
+		return(crcRtrnInvalid);
+	}
+	rtrn=crcRtrnOk;
+	for(token=strtok_r(copy,",",&save);(token!=NULL)&&(rtrn==crcRtrnOk);token=strtok_r(NULL,",",&save)) {
+		char *value;
+		if((value=strchr(token,'='))==NULL) {
+			value=token;
+			token="name";
+		} else {
+			*(value++)='\0';
+		}
+		if(strcasecmp(token,"name")==0) {
+			if((model=crcCatalogueFind(value))!=NULL) {
+				crc->name=model->name;
+				crc->width=model->width;
+				crc->poly=model->poly;
+				crc->init=model->init;
+				crc->refin=model->refin;
+				crc->refout=model->refout;
+				crc->xorout=model->xorout;
+				crc->order=model->order;
+			} else {
+				rtrn=crcRtrnUnknown;
+			}
+		} else if(strcasecmp(token,"width")==0) {
+			crc->width=atoi(value);
+		} else if(strcasecmp(token,"poly")==0) {
+			rtrn=crcValueParse(value,&crc->poly)==0?crcRtrnOk:crcRtrnInvalid;
+		} else if(strcasecmp(token,"init")==0) {
+			rtrn=crcValueParse(value,&crc->init)==0?crcRtrnOk:crcRtrnInvalid;
+		} else if(strcasecmp(token,"xorout")==0) {
+			rtrn=crcValueParse(value,&crc->xorout)==0?crcRtrnOk:crcRtrnInvalid;
+		} else if(strcasecmp(token,"refin")==0) {
+			rtrn=crcBoolParse(value,&crc->refin)==0?crcRtrnOk:crcRtrnInvalid;
+		} else if(strcasecmp(token,"refout")==0) {
+			rtrn=crcBoolParse(value,&crc->refout)==0?crcRtrnOk:crcRtrnInvalid;
+		} else if(strcasecmp(token,"order")==0) {
+			if(strcasecmp(value,"little")==0) {
+				crc->order=crcOrderLittle;
+			} else if(strcasecmp(value,"big")==0) {
+				crc->order=crcOrderBig;
+			} else {
+				rtrn=crcRtrnInvalid;
+			}
+		} else {
+			rtrn=crcRtrnInvalid;
+		}
+	}
+	free(copy);
+
+	/* We work a byte at a time, so the register must at least hold one. And
+	 * without a polynomial there is no crc at all. */
+	if((rtrn==crcRtrnOk)&&((crc->width<8)||(crc->width>64)||(crc->poly==0))) {
+		rtrn=crcRtrnInvalid;
+	}
+	if(rtrn==crcRtrnOk) {
+		crcInitialize(crc);
+	}
+	return(rtrn);
+}
+
+/* Derive the table and friends from the model. Reflected crcs run the
+ * register the other way around, with the reflected polynomial, that way
+ * neither the input bytes nor the register need to be reflected byte by
+ * byte. */
+void crcInitialize(struct crc *crc) {
+	uint64_t poly,remainder,top;
+	int index,bit;
+
+	crc->mask=crc->width==64?~0ULL:(1ULL<<crc->width)-1;
+	crc->poly&=crc->mask;
+	crc->init&=crc->mask;
+	crc->xorout&=crc->mask;
+	if(boolIsSet(crc->refin)) {
+		poly=crcReflect(crc->poly,crc->width);
+		for(index=0;index<256;index++) {
+			for(remainder=index,bit=0;bit<8;bit++) {
+				remainder=(remainder&1)?(remainder>>1)^poly:remainder>>1;
+			}
+			crc->table[index]=remainder;
+		}
+		crc->start=crcReflect(crc->init,crc->width);
+	} else {
+		top=1ULL<<(crc->width-1);
+		for(index=0;index<256;index++) {
+			for(remainder=(uint64_t)index<<(crc->width-8),bit=0;bit<8;bit++) {
+				remainder=(remainder&top)?(remainder<<1)^crc->poly:remainder<<1;
+			}
+			crc->table[index]=remainder&crc->mask;
+		}
+		crc->start=crc->init;
+	}
+}
+
+uint64_t crcCalculate(struct crc *crc,unsigned char *data,int length) {
+	uint64_t remainder;
+	int index;
+	remainder=crc->start;
+	if(boolIsSet(crc->refin)) {
+		for(index=0;index<length;index++) {
+			remainder=(remainder>>8)^crc->table[(remainder^data[index])&0xFF];
+		}
+	} else {
+		int shift=crc->width-8;
+		for(index=0;index<length;index++) {
+			remainder=((remainder<<8)^crc->table[((remainder>>shift)^data[index])&0xFF])&crc->mask;
+		}
+	}
+	if(crc->refin!=crc->refout) {
+		remainder=crcReflect(remainder,crc->width);
+	}
+	return((remainder^crc->xorout)&crc->mask);
+}
+
+/* The amount of bytes the crc takes in the message. */
+int crcSize(struct crc *crc) {
+	return((crc->width+7)/8);
+}
+
+/* Put the crc at the given place in the requested byte order. Returns the
+ * amount of bytes put. */
+int crcPut(struct crc *crc,uint64_t value,unsigned char *data) {
+	int size,index;
+	size=crcSize(crc);
+	for(index=0;index<size;index++) {
+		if(crc->order==crcOrderLittle) {
+			data[index]=(value>>(index*8))&0xFF;
+		} else {
+			data[size-index-1]=(value>>(index*8))&0xFF;
+		}
+	}
+	return(size);
+}
+
+/* Show the user what we've got. Every entry comes with the crc of the
+ * string "123456789", the well known check value. */
+void crcList(FILE *output) {
+	const struct crcModel *model;
+	for(model=crcCatalogue;model->name!=NULL;model++) {
+		struct crc crc;
+		crcParse(&crc,model->name);
+		fprintf(output,"%-20s width=%d poly=%0*llX init=%0*llX refin=%s refout=%s xorout=%0*llX order=%s check=%0*llX\n",
+			crc.name,crc.width,
+			(crc.width+3)/4,(unsigned long long)crc.poly,
+			(crc.width+3)/4,(unsigned long long)crc.init,
+			boolIsSet(crc.refin)?"true":"false",boolIsSet(crc.refout)?"true":"false",
+			(crc.width+3)/4,(unsigned long long)crc.xorout,
+			crc.order==crcOrderLittle?"little":"big",
+			(crc.width+3)/4,(unsigned long long)crcCalculate(&crc,(unsigned char *)"123456789",9)
+		);
+	}
+}
@@ -0,0 +1,65 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __CRC_H
+#define __CRC_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "misc.h"
+
+/* The byte order in which the crc is appended to the message. */
+enum crcOrder {
+	crcOrderLittle=0,
+	crcOrderBig
+};
+
+/* A crc described the Rocksoft way: width, polynomial, initial value,
+ * reflection of input and output and a final xor. Add the byte order in
+ * which we append it to a message and you have about every crc out there.
+ * The table and the rest at the end are derived from the model by
+ * crcInitialize(). */
+struct crc {
+	const char *name;
+	int width;
+	uint64_t poly;
+	uint64_t init;
+	bool_t refin;
+	bool_t refout;
+	uint64_t xorout;
+	enum crcOrder order;
+	uint64_t mask;
+	uint64_t start;
+	uint64_t table[256];
+};
+
+enum crcRtrn {
+	crcRtrnOk=0,
+	crcRtrnUnknown,
+	crcRtrnInvalid
+};
+
+extern enum crcRtrn crcParse(struct crc *,const char *);
+extern void crcInitialize(struct crc *);
+extern uint64_t crcCalculate(struct crc *,unsigned char *,int);
+extern int crcSize(struct crc *);
+extern int crcPut(struct crc *,uint64_t,unsigned char *);
+extern void crcList(FILE *);
+
+#endif
@@ -16,7 +16,9 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
-static unsigned short crcTable[256];
+/* Our tables for slicing-by-8. The first one is the classic byte at a time
+ * table, every next one takes one extra zero byte into account. */
+static unsigned short crcTable[8][256];
 
 static unsigned short calcCRC(unsigned short seed,unsigned short poly,unsigned short data) {
 	unsigned short index;
@@ -34,20 +36,34 @@ static unsigned short calcCRC(unsigned short seed,unsigned short poly,unsigned s
 
 void crc16TableCreate(unsigned short seed,unsigned short poly) {
 	unsigned short index;
+	int slice;
 	for(index=0;index<256;index++) {
-		crcTable[index]=calcCRC(seed,poly,index);
+		crcTable[0][index]=calcCRC(seed,poly,index);
+	}
+	for(index=0;index<256;index++) {
+		for(slice=1;slice<8;slice++) {
+			crcTable[slice][index]=(crcTable[slice-1][index]>>8)^crcTable[0][crcTable[slice-1][index]&0xFF];
+		}
 	}
 }
 
 static unsigned short crcAdd(unsigned short crc,unsigned char byte) {
-	return(crc>>8)^crcTable[(crc&0xFF)^byte];
+	return(crc>>8)^crcTable[0][(crc&0xFF)^byte];
 }
 
 unsigned short crc16Calculate(unsigned char *data,int length) {
 	unsigned short crc;
 	int index;
 	crc=0;
-	for(index=0;index<length;index++) {
+	/* Take 8 bytes at once, as long as we have them. */
+	for(index=0;(length-index)>=8;index+=8) {
+		crc^=data[index]|(data[index+1]<<8);
+		crc=crcTable[7][crc&0xFF]^crcTable[6][crc>>8]^
+			crcTable[5][data[index+2]]^crcTable[4][data[index+3]]^
+			crcTable[3][data[index+4]]^crcTable[2][data[index+5]]^
+			crcTable[1][data[index+6]]^crcTable[0][data[index+7]];
+	}
+	for(;index<length;index++) {
 		crc=crcAdd(crc,data[index]);
 	}
 	return(crc);
@@ -16,25 +16,46 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
-static int _poly=0x07;
+/* Our tables for slicing-by-8. The first one is the classic byte at a time
+ * table, every next one takes one extra zero byte into account. Processing
+ * the bits of every byte least significant bit first and reversing the
+ * result in the end, as we've always done, is exactly the same as running
+ * the reflected algorithm with the reflected polynomial. Which is what our
+ * tables are built for. */
+static unsigned char crcTable[8][256];
 
 void crc8PolyInit(unsigned char poly) {
-	_poly=poly;
+	unsigned char polyReversed;
+	int index,bit;
+	for(polyReversed=0,index=0;index<8;index++) {
+		polyReversed=(polyReversed<<1)|((poly>>index)&1);
+	}
+	for(index=0;index<256;index++) {
+		unsigned char crc;
+		for(crc=index,bit=0;bit<8;bit++) {
+			crc=(crc&1)?(crc>>1)^polyReversed:crc>>1;
+		}
+		crcTable[0][index]=crc;
+	}
+	for(index=0;index<256;index++) {
+		for(bit=1;bit<8;bit++) {
+			crcTable[bit][index]=crcTable[0][crcTable[bit-1][index]];
+		}
+	}
 }
 
 unsigned char crc8Calculate(unsigned char *mssg,int size) {
 	unsigned char crc=0;
-	unsigned char crcReversed=0;
 	int index;
-	for(index=0;index<size*8;index++) {
-		if((crc>>7)^((mssg[index>>3]>>(index&7))&1)) {
-			crc=(crc<<1)^_poly;
-		} else {
-			crc<<=1;
-		}
+	for(index=0;(size-index)>=8;index+=8) {
+		crc=crcTable[7][crc^mssg[index]]^
+			crcTable[6][mssg[index+1]]^crcTable[5][mssg[index+2]]^
+			crcTable[4][mssg[index+3]]^crcTable[3][mssg[index+4]]^
+			crcTable[2][mssg[index+5]]^crcTable[1][mssg[index+6]]^
+			crcTable[0][mssg[index+7]];
 	}
-	for(index=0;index<8;index++) {
-		crcReversed=(crcReversed<<1)|((crc>>index)&1);
+	for(;index<size;index++) {
+		crc=crcTable[0][crc^mssg[index]];
 	}
-	return(crcReversed);
+	return(crc);
 }
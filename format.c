@@ -0,0 +1,146 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "jpnevulator.h"
+#include "interface.h"
+#include "byte.h"
+#include "misc.h"
+#include "format.h"
+
+/* The length of the byte count in front of a line, "%08lX\t". */
+#define FORMAT_BYTE_COUNT_LENGTH 9
+
+/* Our line formatter. Every line is built in a buffer from precomputed tables
+ * and written with a single fwrite(). Only when a chunk of data ends before the
+ * line does, the part built so far is written already, so the user does not
+ * have to wait for the rest of the line to see the bytes. */
+static struct {
+	FILE *output;
+	char *line;
+	int lineLength;
+	char *ascii;
+	int bytesWritten;
+	int byteWidth;
+	char printable[256];
+} _format;
+
+enum formatRtrn formatInitialize(FILE *output) {
+	int size;
+	int byte;
+	_format.output=output;
+	_format.byteWidth=byteWidth(_jpnevulatorOptions.base);
+	/* Room for the byte count, all the bytes with their separators, the ascii
+	 * data behind its tab and the newline. The byte count might be printed with
+	 * more digits than usual, so leave some room for that too. */
+	size=(FORMAT_BYTE_COUNT_LENGTH+(sizeof(unsigned long)*2))+(_jpnevulatorOptions.width*(_format.byteWidth+1))+1+_jpnevulatorOptions.width+1;
+	_format.line=(char *)malloc(size);
+	_format.ascii=(char *)malloc(_jpnevulatorOptions.width);
+	if((_format.line==NULL)||(_format.ascii==NULL)) {
+		formatDestroy();
+		return(formatRtrnMemory);
+	}
+	_format.lineLength=0;
+	_format.bytesWritten=0;
+	for(byte=0;byte<256;byte++) {
+		_format.printable[byte]=isprint(byte)?byte:'.';
+	}
+	return(formatRtrnOk);
+}
+
+static void formatLineWrite(void) {
+	if(_format.lineLength>0) {
+		fwrite(_format.line,1,_format.lineLength,_format.output);
+		_format.lineLength=0;
+	}
+}
+
+static void formatByteCount(unsigned long byteCount) {
+	static const char digits[]="0123456789ABCDEF";
+	char *p;
+	int index;
+	if(byteCount>0xFFFFFFFFUL) {
+		/* Does not happen that often, so let the C library handle it. */
+		_format.lineLength+=sprintf(_format.line+_format.lineLength,"%08lX\t",byteCount);
+		return;
+	}
+	p=_format.line+_format.lineLength;
+	for(index=7;index>=0;index--,byteCount>>=4) {
+		p[index]=digits[byteCount&0x0F];
+	}
+	p[8]='\t';
+	_format.lineLength+=FORMAT_BYTE_COUNT_LENGTH;
+}
+
+/* End the current line, if any. In case it's not complete and fill is set the
+ * ascii data is lined up with the ascii data of the complete lines. */
+void formatLineEnd(bool_t fill) {
+	if(_format.bytesWritten!=0) {
+		if(boolIsSet(_jpnevulatorOptions.ascii)) {
+			if(boolIsSet(fill)&&(_format.bytesWritten<_jpnevulatorOptions.width)) {
+				int spaces;
+				spaces=(_jpnevulatorOptions.width-_format.bytesWritten)*(_format.byteWidth+1);
+				memset(_format.line+_format.lineLength,' ',spaces);
+				_format.lineLength+=spaces;
+			}
+			_format.line[_format.lineLength++]='\t';
+			memcpy(_format.line+_format.lineLength,_format.ascii,_format.bytesWritten);
+			_format.lineLength+=_format.bytesWritten;
+		}
+		_format.line[_format.lineLength++]='\n';
+		formatLineWrite();
+		_format.bytesWritten=0;
+	}
+}
+
+/* Format the bytes read from the given interface. */
+void formatBytes(struct interface *interface,unsigned char *data,int size) {
+	int index;
+	for(index=0;index<size;index++) {
+		if(_format.bytesWritten>=_jpnevulatorOptions.width) {
+			formatLineEnd(boolFalse);
+		} else if(_format.bytesWritten!=0) {
+			_format.line[_format.lineLength++]=' ';
+		}
+		if((_format.bytesWritten==0)&&boolIsSet(_jpnevulatorOptions.byteCountDisplay)) {
+			formatByteCount(interface->byteCount);
+		}
+		memcpy(_format.line+_format.lineLength,byteString(_jpnevulatorOptions.base,data[index]),_format.byteWidth);
+		_format.lineLength+=_format.byteWidth;
+		/* Increase the byte count for this interface. */
+		interface->byteCount++;
+		_format.ascii[_format.bytesWritten]=_format.printable[data[index]];
+		_format.bytesWritten++;
+	}
+	formatLineWrite();
+}
+
+void formatDestroy(void) {
+	if(_format.line!=NULL) {
+		free(_format.line);
+		_format.line=NULL;
+	}
+	if(_format.ascii!=NULL) {
+		free(_format.ascii);
+		_format.ascii=NULL;
+	}
+}
@@ -0,0 +1,240 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+
+#include "jpnevulator.h"
+#include "interface.h"
+#include "queue.h"
+#include "stats.h"
+#include "forward.h"
+
+/* Every interface gets two pipes. The bytes read from it are spliced into its
+ * in pipe, from where they are teed into the out pipe of every other interface
+ * and spliced on to them. This way the bytes we pass on never leave the kernel.
+ * The bytes in the in pipe are read in the end, since we want to display them.
+ * Not every interface supports splicing, those simply get read and written. */
+struct forwardPort {
+	struct interface *interface;
+	int in[2];
+	int out[2];
+	int size;
+	bool_t spliceIn;
+	bool_t spliceOut;
+};
+
+static struct forwardPort *_ports=NULL;
+static int _portsCount=0;
+/* Room to get rid of bytes stuck in an out pipe. */
+static unsigned char *_scratch=NULL;
+
+/* Every interface has got a port, at the position of its id. */
+static struct forwardPort *forwardPortFind(struct interface *interface) {
+	if(interface->id<_portsCount) {
+		return(&_ports[interface->id]);
+	}
+	return(NULL);
+}
+
+/* Get ready to pass the bytes read between all our interfaces. Without splice
+ * we simply write what we read. */
+enum forwardRtrn forwardInitialize(bool_t splice) {
+	struct interface *interface;
+	int id;
+	_portsCount=0;
+	_ports=(struct forwardPort *)calloc(max(1,interfaceCount()),sizeof(struct forwardPort));
+	if(_ports==NULL) {
+		return(forwardRtrnMemory);
+	}
+	for(id=0;id<interfaceCount();id++) {
+		struct forwardPort *port;
+		interface=interfaceGet(id);
+		port=&_ports[_portsCount++];
+		port->interface=interface;
+		port->in[0]=port->in[1]=port->out[0]=port->out[1]=-1;
+		boolReset(port->spliceIn);
+		boolReset(port->spliceOut);
+		if(boolIsSet(splice)) {
+			if((pipe2(port->in,O_CLOEXEC)!=0)||(pipe2(port->out,O_CLOEXEC)!=0)) {
+				return(forwardRtrnPipe);
+			}
+			/* Try to make the pipes as big as our buffer. They keep their default
+			 * size if we are not allowed to, that's fine too, we just splice less
+			 * at once. */
+			fcntl(port->in[1],F_SETPIPE_SZ,_jpnevulatorOptions.bufferSize);
+			fcntl(port->out[1],F_SETPIPE_SZ,_jpnevulatorOptions.bufferSize);
+			port->size=min(fcntl(port->in[1],F_GETPIPE_SZ),fcntl(port->out[1],F_GETPIPE_SZ));
+			if(port->size<=0) {
+				return(forwardRtrnPipe);
+			}
+			boolSet(port->spliceIn);
+			boolSet(port->spliceOut);
+		}
+	}
+	_scratch=(unsigned char *)malloc(_jpnevulatorOptions.bufferSize);
+	if(_scratch==NULL) {
+		return(forwardRtrnMemory);
+	}
+	return(forwardRtrnOk);
+}
+
+static void forwardWriteError(struct interface *interface,ssize_t size,ssize_t n) {
+	fprintf(stderr,"%s: %s: write of %ld bytes failed(%ld).\n",PROGRAM_NAME,interfacePrint(interface),(long)size,(long)n);
+}
+
+/* Write the given bytes to all interfaces but the one they came from. */
+void forwardWrite(struct interface *interfaceReader,unsigned char *data,ssize_t size) {
+	int index;
+	for(index=0;index<_portsCount;index++) {
+		struct interface *interfaceWriter;
+		interfaceWriter=_ports[index].interface;
+		if(interfaceWriter->id!=interfaceReader->id) {
+			ssize_t n;
+			n=queueWrite(interfaceWriter,data,size);
+			if(n<0) {
+				forwardWriteError(interfaceWriter,size,n);
+			}
+		}
+	}
+}
+
+/* Splice all that's in the out pipe of the given port to its interface. Returns
+ * the amount of bytes that were in the pipe but didn't make it to the interface.
+ * These are gone from the pipe too, so it's empty for the next time. */
+static ssize_t forwardDrain(struct forwardPort *port,ssize_t size) {
+	while(size>0) {
+		ssize_t n,left;
+		n=splice(port->out[0],NULL,port->interface->fd,NULL,size,0);
+		if(n>0) {
+			size-=n;
+		} else if((n<0)&&(errno==EINTR)) {
+			continue;
+		} else {
+			/* This interface doesn't like to be spliced to, can't take any more
+			 * right now or is in trouble. Empty the pipe, the caller takes care
+			 * of the bytes left. */
+			if((n<0)&&(errno==EINVAL)) {
+				boolReset(port->spliceOut);
+			}
+			for(left=size;left>0;) {
+				n=read(port->out[0],_scratch,min(left,_jpnevulatorOptions.bufferSize));
+				if(n>0) {
+					left-=n;
+				} else if((n==0)||(errno!=EINTR)) {
+					break;
+				}
+			}
+			return(size);
+		}
+	}
+	return(0);
+}
+
+/* Read at most size bytes from the given interface and pass them on to all the
+ * other interfaces. The bytes read are returned in data, so they can be displayed. */
+ssize_t forwardRead(struct interface *interfaceReader,unsigned char *data,size_t size) {
+	struct forwardPort *port;
+	ssize_t n;
+	int index;
+	port=forwardPortFind(interfaceReader);
+	if((port!=NULL)&&boolIsSet(port->spliceIn)) {
+		n=splice(interfaceReader->fd,NULL,port->in[1],NULL,min(size,port->size),0);
+		if((n<0)&&(errno==EINVAL)) {
+			/* Not every kind of interface supports splice, fall back to reading. */
+			boolReset(port->spliceIn);
+		} else {
+			ssize_t left[_portsCount];
+			if(n<=0) {
+				return(n);
+			}
+			/* Hand a copy to all the others, still inside the kernel. */
+			for(index=0;index<_portsCount;index++) {
+				struct forwardPort *writer;
+				writer=&_ports[index];
+				left[index]=n;
+				if(writer==port) {
+					left[index]=0;
+				} else if(boolIsSet(writer->spliceOut)&&((writer->interface->queue==NULL)||(writer->interface->queue->length==0))) {
+					/* Bytes already waiting in the queue of this interface go first,
+					 * so only splice if there are none. */
+					ssize_t teed;
+					teed=tee(port->in[0],writer->out[1],n,0);
+					if(teed<0) {
+						if(errno==EINVAL) {
+							boolReset(writer->spliceOut);
+						}
+						teed=0;
+					}
+					left[index]=n-teed+forwardDrain(writer,teed);
+					/* These bytes never pass a queue, so count them here. */
+					if(left[index]<n) {
+						statsWrite(writer->interface,n-left[index]);
+					}
+				}
+			}
+			/* Now get the bytes ourself, we need to display them. */
+			n=read(port->in[0],data,n);
+			/* Whatever did not make it through the kernel gets written the old way. */
+			for(index=0;(n>0)&&(index<_portsCount);index++) {
+				if(left[index]>0) {
+					ssize_t written;
+					written=queueWrite(_ports[index].interface,&(data[n-left[index]]),left[index]);
+					if(written<0) {
+						forwardWriteError(_ports[index].interface,left[index],written);
+					}
+				}
+			}
+			return(n);
+		}
+	}
+	n=read(interfaceReader->fd,data,size);
+	if(n>0) {
+		forwardWrite(interfaceReader,data,n);
+	}
+	return(n);
+}
+
+void forwardDestroy(void) {
+	int index;
+	if(_ports!=NULL) {
+		for(index=0;index<_portsCount;index++) {
+			int pipeIndex;
+			for(pipeIndex=0;pipeIndex<2;pipeIndex++) {
+				if(_ports[index].in[pipeIndex]!=-1) {
+					close(_ports[index].in[pipeIndex]);
+				}
+				if(_ports[index].out[pipeIndex]!=-1) {
+					close(_ports[index].out[pipeIndex]);
+				}
+			}
+		}
+		free(_ports);
+		_ports=NULL;
+	}
+	_portsCount=0;
+	if(_scratch!=NULL) {
+		free(_scratch);
+		_scratch=NULL;
+	}
+}
@@ -0,0 +1,154 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "frame.h"
+
+/* Parsing a big input file and calculating all its checksums over and over
+ * again is a waste if it's sent many times. So we do it only once and store
+ * the messages the way they go out on the line. Sending them is nothing more
+ * than mapping the file and handing out pointers into it. */
+static struct {
+	/* Compiling. */
+	FILE *file;
+	uint32_t frames;
+	/* Sending. */
+	unsigned char *map;
+	size_t size;
+	size_t position;
+} _frame={NULL,0,NULL,0,0};
+
+enum frameRtrn frameCreate(const char *name) {
+	struct frameHeader header;
+	_frame.file=fopen(name,"w");
+	if(_frame.file==NULL) {
+		return(frameRtrnOpen);
+	}
+	_frame.frames=0;
+	/* We don't know the amount of frames yet, the header is written once more
+	 * when we are done. */
+	memset(&header,0,sizeof(header));
+	memcpy(header.magic,FRAME_MAGIC,sizeof(header.magic));
+	header.version=FRAME_VERSION;
+	header.byteOrder=FRAME_BYTE_ORDER;
+	if(fwrite(&header,sizeof(header),1,_frame.file)!=1) {
+		return(frameRtrnWrite);
+	}
+	return(frameRtrnOk);
+}
+
+enum frameRtrn frameAdd(unsigned char *data,int size) {
+	uint32_t length;
+	length=size;
+	if(
+		(fwrite(&length,sizeof(length),1,_frame.file)!=1)||
+		(fwrite(data,1,length,_frame.file)!=length)
+	) {
+		return(frameRtrnWrite);
+	}
+	_frame.frames++;
+	return(frameRtrnOk);
+}
+
+enum frameRtrn frameClose(void) {
+	struct frameHeader header;
+	enum frameRtrn rtrn;
+	if(_frame.file==NULL) {
+		return(frameRtrnOk);
+	}
+	rtrn=frameRtrnOk;
+	memset(&header,0,sizeof(header));
+	memcpy(header.magic,FRAME_MAGIC,sizeof(header.magic));
+	header.version=FRAME_VERSION;
+	header.byteOrder=FRAME_BYTE_ORDER;
+	header.frames=_frame.frames;
+	if((fseek(_frame.file,0L,SEEK_SET)!=0)||(fwrite(&header,sizeof(header),1,_frame.file)!=1)) {
+		rtrn=frameRtrnWrite;
+	}
+	if(fclose(_frame.file)!=0) {
+		rtrn=frameRtrnWrite;
+	}
+	_frame.file=NULL;
+	return(rtrn);
+}
+
+/* Map the compiled message file behind the given file descriptor. Returns
+ * frameRtrnNone if it's no compiled message file at all, which is the case for
+ * anything that is not a regular file. */
+enum frameRtrn frameMap(int fd) {
+	struct frameHeader header;
+	struct stat status;
+	if(
+		(fstat(fd,&status)!=0)||!S_ISREG(status.st_mode)||
+		(status.st_size<sizeof(header))||
+		(pread(fd,&header,sizeof(header),0)!=sizeof(header))||
+		(memcmp(header.magic,FRAME_MAGIC,sizeof(header.magic))!=0)
+	) {
+		return(frameRtrnNone);
+	}
+	if((header.version!=FRAME_VERSION)||(header.byteOrder!=FRAME_BYTE_ORDER)) {
+		return(frameRtrnFormat);
+	}
+	_frame.size=status.st_size;
+	_frame.map=(unsigned char *)mmap(NULL,_frame.size,PROT_READ,MAP_PRIVATE,fd,0);
+	if(_frame.map==MAP_FAILED) {
+		_frame.map=NULL;
+		return(frameRtrnMap);
+	}
+	/* We walk through it once, from front to back. */
+	madvise(_frame.map,_frame.size,MADV_SEQUENTIAL);
+	madvise(_frame.map,_frame.size,MADV_WILLNEED);
+	_frame.position=sizeof(header);
+	return(frameRtrnOk);
+}
+
+/* Hand out the next frame, straight from the map. */
+enum frameRtrn frameNext(unsigned char **data,int *size) {
+	uint32_t length;
+	if(_frame.position==_frame.size) {
+		return(frameRtrnEOF);
+	}
+	if((_frame.size-_frame.position)<sizeof(length)) {
+		return(frameRtrnFormat);
+	}
+	memcpy(&length,&(_frame.map[_frame.position]),sizeof(length));
+	_frame.position+=sizeof(length);
+	if((_frame.size-_frame.position)<length) {
+		return(frameRtrnFormat);
+	}
+	*data=&(_frame.map[_frame.position]);
+	*size=length;
+	_frame.position+=length;
+	return(frameRtrnOk);
+}
+
+void frameUnmap(void) {
+	if(_frame.map!=NULL) {
+		munmap(_frame.map,_frame.size);
+		_frame.map=NULL;
+	}
+	_frame.size=0;
+	_frame.position=0;
+}
@@ -0,0 +1,57 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __FRAME_H
+#define __FRAME_H
+
+#include <stdint.h>
+
+/* A compiled message file starts with a header, followed by the messages
+ * (frames), one after the other. Every frame is its length followed by its
+ * bytes, checksum included. Everything is written in the byte order of the
+ * machine that compiled it. */
+#define FRAME_MAGIC "JPNEVMSG"
+#define FRAME_VERSION 1
+#define FRAME_BYTE_ORDER 0x01020304
+
+struct frameHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t frames;
+	uint32_t reserved;
+};
+
+enum frameRtrn {
+	frameRtrnOk=0,
+	frameRtrnOpen,
+	frameRtrnWrite,
+	frameRtrnNone,
+	frameRtrnFormat,
+	frameRtrnMap,
+	frameRtrnEOF
+};
+
+extern enum frameRtrn frameCreate(const char *);
+extern enum frameRtrn frameAdd(unsigned char *,int);
+extern enum frameRtrn frameClose(void);
+extern enum frameRtrn frameMap(int);
+extern enum frameRtrn frameNext(unsigned char **,int *);
+extern void frameUnmap(void);
+
+#endif
@@ -0,0 +1,98 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "histogram.h"
+
+/* The bucket a value belongs to. The first HISTOGRAM_SUB_BUCKETS values have a
+ * bucket of their own. From there on every power of two gets the same amount
+ * of buckets, each twice as wide as the ones of the power of two before. The
+ * bits right below the highest bit set tell which one of them it is. */
+static int histogramBucket(unsigned long long value) {
+	int shift;
+	if(value<HISTOGRAM_SUB_BUCKETS) {
+		return((int)value);
+	}
+	shift=63-__builtin_clzll(value)-HISTOGRAM_SUB_BITS;
+	return(((shift+1)*HISTOGRAM_SUB_BUCKETS)+(int)((value>>shift)-HISTOGRAM_SUB_BUCKETS));
+}
+
+/* The smallest value that ends up in the given bucket... */
+unsigned long long histogramBucketLow(int bucket) {
+	int shift;
+	if(bucket<HISTOGRAM_SUB_BUCKETS) {
+		return((unsigned long long)bucket);
+	}
+	shift=(bucket/HISTOGRAM_SUB_BUCKETS)-1;
+	return((unsigned long long)(HISTOGRAM_SUB_BUCKETS+(bucket%HISTOGRAM_SUB_BUCKETS))<<shift);
+}
+
+/* ...and the biggest one. */
+unsigned long long histogramBucketHigh(int bucket) {
+	int shift;
+	if(bucket<HISTOGRAM_SUB_BUCKETS) {
+		return((unsigned long long)bucket);
+	}
+	shift=(bucket/HISTOGRAM_SUB_BUCKETS)-1;
+	return(histogramBucketLow(bucket)+((1ULL<<shift)-1ULL));
+}
+
+/* Add the given value the given amount of times. */
+void histogramAdd(struct histogram *histogram,unsigned long long value,unsigned long long times) {
+	if(times==0) {
+		return;
+	}
+	if((histogram->count==0)||(value<histogram->min)) {
+		histogram->min=value;
+	}
+	if(value>histogram->max) {
+		histogram->max=value;
+	}
+	histogram->count+=times;
+	histogram->bucket[histogramBucket(value)]+=times;
+}
+
+/* The value the given percentage of all values is smaller than or equal to.
+ * Since we only know the bucket a value went into, we take the biggest value
+ * of that bucket. Never more than the biggest value we have seen though. */
+unsigned long long histogramPercentile(struct histogram *histogram,double percent) {
+	unsigned long long rank,seen;
+	int bucket;
+	if(histogram->count==0) {
+		return(0ULL);
+	}
+	/* The rank of that value, rounded up. */
+	rank=(unsigned long long)((percent/100.0)*histogram->count);
+	if((double)rank<(percent/100.0)*histogram->count) {
+		rank++;
+	}
+	if(rank<1) {
+		rank=1;
+	} else if(rank>histogram->count) {
+		rank=histogram->count;
+	}
+	for(seen=0,bucket=0;bucket<HISTOGRAM_BUCKETS;bucket++) {
+		seen+=histogram->bucket[bucket];
+		if(seen>=rank) {
+			break;
+		}
+	}
+	if(histogramBucketHigh(bucket)>histogram->max) {
+		return(histogram->max);
+	}
+	return(histogramBucketHigh(bucket));
+}
@@ -0,0 +1,42 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __HISTOGRAM_H
+#define __HISTOGRAM_H
+
+/* Every power of two is split up in this many buckets. That way a value is
+ * never more than 1/16th (a little over 6%) off, no matter how small or big it
+ * is. Values smaller than the amount of buckets per power of two are exact. */
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1<<HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((64-HISTOGRAM_SUB_BITS+1)*HISTOGRAM_SUB_BUCKETS)
+
+/* All of it is fixed in size, so adding a value never allocates anything. */
+struct histogram {
+	unsigned long long count;
+	unsigned long long min;
+	unsigned long long max;
+	unsigned long long bucket[HISTOGRAM_BUCKETS];
+};
+
+extern void histogramAdd(struct histogram *,unsigned long long,unsigned long long);
+extern unsigned long long histogramPercentile(struct histogram *,double);
+extern unsigned long long histogramBucketLow(int);
+extern unsigned long long histogramBucketHigh(int);
+
+#endif
@@ -19,23 +19,136 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
 #include "options.h"
 #include "jpnevulator.h"
 #include "interface.h"
-#include "list.h"
 
-void interfaceInitialize(void) {
-	listInitialize(&_jpnevulatorOptions.interface);
+/* The amount of interfaces we make room for at once. */
+#define INTERFACE_TABLE_GROW 8
+/* The amount of slots our hash tables start with. They double in size once
+ * they are half full, so a search hardly ever needs more than one try. */
+#define INTERFACE_HASH_SLOTS 64
+
+struct interfaceTable _interfaceTable={NULL,NULL,0,0};
+
+/* Every name and alias is kept only once, no matter how many interfaces use
+ * it, and no matter how long it is. The strings are found back by their hash. */
+static struct {
+	char **slot;
+	unsigned int mask;
+	unsigned int count;
+} _interfaceStrings={NULL,0,0};
+
+/* And every interface is found back by the hash of its name. Names of
+ * interfaces are not case sensitive, so neither is this hash. Every slot holds
+ * the id of the interface or -1 if it's empty. */
+static struct {
+	int *slot;
+	unsigned int mask;
+	unsigned int count;
+} _interfaceIndex={NULL,0,0};
+
+/* FNV-1a, optionally not caring about case. */
+static unsigned int interfaceHash(char *string,bool_t caseless) {
+	unsigned int hash;
+	hash=2166136261U;
+	for(;*string!='\0';string++) {
+		hash^=(unsigned char)(boolIsSet(caseless)?tolower((unsigned char)*string):*string);
+		hash*=16777619U;
+	}
+	return(hash);
+}
+
+/* Give back our own copy of the given string. The same string always gets
+ * the same copy, so two of them are equal if their pointers are. Returns NULL
+ * if we ran out of memory. */
+char *interfaceIntern(char *string) {
+	unsigned int index;
+	if((_interfaceStrings.slot==NULL)||((_interfaceStrings.count*2)>=(_interfaceStrings.mask+1))) {
+		char **slot;
+		unsigned int size,n;
+		size=_interfaceStrings.slot==NULL?INTERFACE_HASH_SLOTS:(_interfaceStrings.mask+1)*2;
+		slot=(char **)calloc(size,sizeof(slot[0]));
+		if(slot==NULL) {
+			return(NULL);
+		}
+		for(n=0;(_interfaceStrings.slot!=NULL)&&(n<=_interfaceStrings.mask);n++) {
+			if(_interfaceStrings.slot[n]!=NULL) {
+				for(index=interfaceHash(_interfaceStrings.slot[n],boolFalse)&(size-1);slot[index]!=NULL;index=(index+1)&(size-1));
+				slot[index]=_interfaceStrings.slot[n];
+			}
+		}
+		free(_interfaceStrings.slot);
+		_interfaceStrings.slot=slot;
+		_interfaceStrings.mask=size-1;
+	}
+	for(index=interfaceHash(string,boolFalse)&_interfaceStrings.mask;_interfaceStrings.slot[index]!=NULL;index=(index+1)&_interfaceStrings.mask) {
+		if(strcmp(_interfaceStrings.slot[index],string)==0) {
+			return(_interfaceStrings.slot[index]);
+		}
+	}
+	if((_interfaceStrings.slot[index]=strdup(string))!=NULL) {
+		_interfaceStrings.count++;
+	}
+	return(_interfaceStrings.slot[index]);
+}
+
+static void interfaceIndexInsert(int *slot,unsigned int mask,int id) {
+	unsigned int index;
+	for(index=interfaceHash(interfaceName(interfaceGet(id)),boolTrue)&mask;slot[index]!=-1;index=(index+1)&mask);
+	slot[index]=id;
+}
+
+/* Add the interface with the given id to our index. */
+static enum interfaceRtrn interfaceIndexAdd(int id) {
+	if((_interfaceIndex.slot==NULL)||((_interfaceIndex.count*2)>=(_interfaceIndex.mask+1))) {
+		unsigned int size,n;
+		int *slot;
+		size=_interfaceIndex.slot==NULL?INTERFACE_HASH_SLOTS:(_interfaceIndex.mask+1)*2;
+		slot=(int *)malloc(size*sizeof(slot[0]));
+		if(slot==NULL) {
+			return(interfaceRtrnMemory);
+		}
+		memset(slot,-1,size*sizeof(slot[0]));
+		for(n=0;(_interfaceIndex.slot!=NULL)&&(n<=_interfaceIndex.mask);n++) {
+			if(_interfaceIndex.slot[n]!=-1) {
+				interfaceIndexInsert(slot,size-1,_interfaceIndex.slot[n]);
+			}
+		}
+		free(_interfaceIndex.slot);
+		_interfaceIndex.slot=slot;
+		_interfaceIndex.mask=size-1;
+	}
+	interfaceIndexInsert(_interfaceIndex.slot,_interfaceIndex.mask,id);
+	_interfaceIndex.count++;
+	return(interfaceRtrnOk);
+}
+
+/* Find the interface with the given name, whatever its case. */
+struct interface *interfaceFind(char *name) {
+	unsigned int index;
+	if(_interfaceIndex.slot==NULL) {
+		return(NULL);
+	}
+	for(index=interfaceHash(name,boolTrue)&_interfaceIndex.mask;_interfaceIndex.slot[index]!=-1;index=(index+1)&_interfaceIndex.mask) {
+		if(strcasecmp(interfaceName(interfaceGet(_interfaceIndex.slot[index])),name)==0) {
+			return(interfaceGet(_interfaceIndex.slot[index]));
+		}
+	}
+	return(NULL);
 }
 
-static int cmpr(void *p,void *q) {
-	return(!strcasecmp(((struct interface *)p)->name,(char *)q));
+void interfaceInitialize(void) {
+	_interfaceTable.interface=NULL;
+	_interfaceTable.cold=NULL;
+	_interfaceTable.count=0;
+	_interfaceTable.size=0;
 }
 
-enum interfaceRtrn interfaceAdd(char *name,int (*interfaceOpen)(char *,int),int (*interfaceControlGet)(int,char *),void (*interfaceControlWrite)(FILE *,int),void (*interfaceClose)(int)) {
+enum interfaceRtrn interfaceAdd(char *name,int (*interfaceOpen)(char **),int (*interfaceControlGet)(int,char *),void (*interfaceControlWrite)(FILE *,int),void (*interfaceClose)(int)) {
 	struct interface *interface;
-	int charactersPrinted;
 	char error[1024];
 	char *alias;
 	/* Was an interface name given? */
@@ -43,38 +156,53 @@ enum interfaceRtrn interfaceAdd(char *name,int (*interfaceOpen)(char *,int),int
 		/* Nope. Since the interface name is optional for certain types of interfaces, make sure
 		 * we have some sort of empty value to work with. */
 		name="";
-	} else {
-		/* Is this interface already present in our list of interfaces? */
-		if(listSearch(&_jpnevulatorOptions.interface,cmpr,(void *)name)!=NULL) {
-			return(interfaceRtrnDouble);
-		}
 	}
-	interface=(struct interface *)malloc(sizeof(struct interface));
-	if(interface==NULL) {
-		return(interfaceRtrnMemory);
+	/* Make room for one more in our table of interfaces. Every interface
+	 * starts at a cache line of its own, which realloc() doesn't care about. */
+	if(_interfaceTable.count==_interfaceTable.size) {
+		struct interfaceCold *cold;
+		void *table;
+		if(posix_memalign(&table,_Alignof(struct interface),sizeof(struct interface)*(_interfaceTable.size+INTERFACE_TABLE_GROW))!=0) {
+			return(interfaceRtrnMemory);
+		}
+		cold=(struct interfaceCold *)realloc(_interfaceTable.cold,sizeof(struct interfaceCold)*(_interfaceTable.size+INTERFACE_TABLE_GROW));
+		if(cold==NULL) {
+			free(table);
+			return(interfaceRtrnMemory);
+		}
+		if(_interfaceTable.interface!=NULL) {
+			memcpy(table,_interfaceTable.interface,sizeof(struct interface)*_interfaceTable.count);
+			free(_interfaceTable.interface);
+		}
+		_interfaceTable.interface=(struct interface *)table;
+		_interfaceTable.cold=cold;
+		_interfaceTable.size+=INTERFACE_TABLE_GROW;
 	}
+	interface=interfaceGet(_interfaceTable.count);
+	interface->id=_interfaceTable.count;
 	/* Did the user give us an alias for the interface name? */
 	if((alias=strstr(name,_jpnevulatorOptions.aliasSeparator))!=NULL) {
 		/* Yes, so split the alias from the name. */
 		*alias='\0';
 		/* Advance the alias to the real beginning of it. */
 		alias+=strlen(_jpnevulatorOptions.aliasSeparator);
-		/* And put it in our alias reference. */
-		charactersPrinted=sprintf(interface->alias,"%.*s",(int)sizeof(interface->alias)-1,alias);
-		if(charactersPrinted!=strlen(alias)) {
-			fprintf(stderr,"%s: interface alias %s truncated to %d chars -> %s\n",PROGRAM_NAME,alias,charactersPrinted,interface->alias);
-		}
 	} else {
-		/* No, empty the alias. */
-		strcpy(interface->alias,"");
+		/* No, use an empty alias. */
+		alias="";
 	}
-	charactersPrinted=sprintf(interface->name,"%.*s",(int)sizeof(interface->name)-1,name);
-	if(charactersPrinted!=strlen(name)) {
-		fprintf(stderr,"%s: interface %s truncated to %d chars -> %s\n",PROGRAM_NAME,name,charactersPrinted,interface->name);
+	/* Is this interface already present in our table of interfaces? */
+	if((strlen(name)>0)&&(interfaceFind(name)!=NULL)) {
+		return(interfaceRtrnDouble);
 	}
-	interface->fd=interfaceOpen(interface->name,sizeof(interface->name)-1);
+	interfaceName(interface)=interfaceIntern(name);
+	interfaceAlias(interface)=interfaceIntern(alias);
+	if((interfaceName(interface)==NULL)||(interfaceAlias(interface)==NULL)) {
+		return(interfaceRtrnMemory);
+	}
+	/* Some interfaces only know their name once they are opened. */
+	interface->fd=interfaceOpen(&interfaceName(interface));
 	if(interface->fd==-1) {
-		snprintf(error,sizeof(error)-1,"%s: Unable to open interface %s",PROGRAM_NAME,interface->name);
+		snprintf(error,sizeof(error)-1,"%s: Unable to open interface %s",PROGRAM_NAME,interfaceName(interface));
 		perror(error);
 		return(interfaceRtrnOpen);
 	}
@@ -82,37 +210,53 @@ enum interfaceRtrn interfaceAdd(char *name,int (*interfaceOpen)(char *,int),int
 	interface->byteCount=0UL;
 	/* Put the control call-back in place and get the current state of the control bits if needed. */
 	interface->controlGet=interfaceControlGet;
-	interface->controlWrite=interfaceControlWrite;
+	_interfaceTable.cold[interface->id].controlWrite=interfaceControlWrite;
+	interface->controlWait=NULL;
+	interface->queue=NULL;
+	interface->reactor=NULL;
 	if(boolIsSet(_jpnevulatorOptions.control)) {
-		interface->control=interfaceControlGet(interface->fd,interface->name);
-	}
-	/* Add our interface to the list of interfaces. */
-	if(listAppend(&_jpnevulatorOptions.interface,(void *)interface)!=listRtrnOk) {
-		fprintf(stderr,"%s: unable to add interface %s to the list of interfaces!\n",PROGRAM_NAME,interface->name);
-		return(interfaceRtrnList);
+		interface->control=interfaceControlGet(interface->fd,interfaceName(interface));
 	}
 	/* Store a reference to the function to close this interface. */
-	interface->close=interfaceClose;
-	/* Advance to this next position. so all interfaces will be inline with the order the user gave us. */
-	listNext(&_jpnevulatorOptions.interface);
+	_interfaceTable.cold[interface->id].close=interfaceClose;
+	if(interfaceIndexAdd(interface->id)!=interfaceRtrnOk) {
+		interfaceClose(interface->fd);
+		return(interfaceRtrnMemory);
+	}
+	/* Our interface is in the table now, right after the ones the user gave
+	 * us before. */
+	_interfaceTable.count++;
 	return(interfaceRtrnOk);
 }
 
 int interfaceControlGet(struct interface *interface) {
-	return(interface->controlGet(interface->fd,interface->name));
+	return(interface->controlGet(interface->fd,interfaceName(interface)));
 }
 
 void interfaceControlWrite(struct interface *interface,FILE *output,int control) {
-	interface->controlWrite(output,control);
-}
-
-static void garbageCollect(void *data) {
-	struct interface *interface;
-	interface=(struct interface *)data;
-	interface->close(interface->fd);
-	free(interface);
+	_interfaceTable.cold[interface->id].controlWrite(output,control);
 }
 
 void interfaceDestroy(void) {
-	listDestroy(&_jpnevulatorOptions.interface,garbageCollect);
+	int id;
+	for(id=0;id<interfaceCount();id++) {
+		_interfaceTable.cold[id].close(interfaceGet(id)->fd);
+	}
+	free(_interfaceTable.interface);
+	free(_interfaceTable.cold);
+	interfaceInitialize();
+	free(_interfaceIndex.slot);
+	_interfaceIndex.slot=NULL;
+	_interfaceIndex.mask=0;
+	_interfaceIndex.count=0;
+	if(_interfaceStrings.slot!=NULL) {
+		unsigned int n;
+		for(n=0;n<=_interfaceStrings.mask;n++) {
+			free(_interfaceStrings.slot[n]);
+		}
+		free(_interfaceStrings.slot);
+	}
+	_interfaceStrings.slot=NULL;
+	_interfaceStrings.mask=0;
+	_interfaceStrings.count=0;
 }
@@ -19,30 +19,81 @@
 #ifndef __INTERFACE_H
 #define __INTERFACE_H
 
-#define INTERFACE_NAME_LENGTH 512
+#include "misc.h"
 
+/* The amount of changes of the modem input lines, as far as an interface is able
+ * to count them. Only valid once somebody filled it in. */
+struct interfaceControlCount {
+	bool_t valid;
+	int cts;
+	int dsr;
+	int ri;
+	int cd;
+};
+
+struct queue;
+struct reactorHandler;
+
+/* Everything we need of an interface for every byte read or written. It fits
+ * in a single cache line, so walking all interfaces touches as little memory
+ * as possible. */
 struct interface {
-	char name[INTERFACE_NAME_LENGTH+1];
-	char alias[INTERFACE_NAME_LENGTH+1];
+	/* Our position in the table of interfaces, see below. */
+	_Alignas(64) int id;
 	int fd;
-	unsigned long byteCount;
 	int control;
-	void (*close)(int);
+	unsigned long byteCount;
+	/* The bytes waiting to be written to this interface, if any. */
+	struct queue *queue;
+	/* How the reactor knows this interface, once it does. */
+	struct reactorHandler *reactor;
 	int (*controlGet)(int,char *);
+	/* Only present if the interface can tell us when its modem control bits change,
+	 * so we don't need to poll for them. */
+	int (*controlWait)(int,struct interfaceControlCount *);
+};
+
+/* And everything we only need now and then, like when the interface is shown
+ * to the user. It lives in a table of its own, at the same position. */
+struct interfaceCold {
+	/* Both are interned (see interfaceIntern()), so never change them in place. */
+	char *name;
+	char *alias;
+	void (*close)(int);
 	void (*controlWrite)(FILE *,int);
 };
 
+/* All our interfaces live next to each other in one table, in the order the user
+ * gave them, and the id of an interface is its position in there. So walking
+ * them all is a simple loop and the id of an interface can be used to find it
+ * back right away. The table grows while interfaces are added, so don't hold on
+ * to an interface until all of them are there. */
+struct interfaceTable {
+	struct interface *interface;
+	struct interfaceCold *cold;
+	int count;
+	int size;
+};
+
+extern struct interfaceTable _interfaceTable;
+
+#define interfaceCount() (_interfaceTable.count)
+#define interfaceGet(x) (&(_interfaceTable.interface[(x)]))
+#define interfaceName(x) (_interfaceTable.cold[(x)->id].name)
+#define interfaceAlias(x) (_interfaceTable.cold[(x)->id].alias)
+
 enum interfaceRtrn {
 	interfaceRtrnOk=0,
 	interfaceRtrnDouble,
 	interfaceRtrnMemory,
-	interfaceRtrnOpen,
-	interfaceRtrnList
+	interfaceRtrnOpen
 };
 
-#define interfacePrint(x) (strlen((x)->alias)>0?(x)->alias:(x)->name)
+#define interfacePrint(x) (interfaceAlias(x)[0]!='\0'?interfaceAlias(x):interfaceName(x))
 extern void interfaceInitialize(void);
-extern enum interfaceRtrn interfaceAdd(char *,int (*)(char *,int),int (*)(int,char *),void (*)(FILE *,int),void (*)(int));
+extern char *interfaceIntern(char *);
+extern struct interface *interfaceFind(char *);
+extern enum interfaceRtrn interfaceAdd(char *,int (*)(char **),int (*)(int,char *),void (*)(FILE *,int),void (*)(int));
 extern int interfaceControlGet(struct interface *);
 extern void interfaceControlWrite(struct interface *,FILE *,int);
 extern void interfaceDestroy(void);
@@ -24,7 +24,6 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <time.h>
-#include <ctype.h>
 
 #include "jpnevulator.h"
 #include "byte.h"
@@ -33,13 +32,33 @@
 #include "checksum.h"
 #include "crc16.h"
 #include "crc8.h"
+#include "crc.h"
 #include "misc.h"
+#include "reactor.h"
+#include "reader.h"
+#include "format.h"
+#include "timestamp.h"
+#include "capture.h"
+#include "monitor.h"
+#include "forward.h"
+#include "queue.h"
+#include "writer.h"
+#include "pace.h"
+#include "replay.h"
+#include "frame.h"
+#include "pipeline.h"
+#include "stats.h"
 
 struct jpnevulatorOptions _jpnevulatorOptions;
 
 static void messageChecksumAdd(unsigned char *message,int *size) {
 	unsigned short checksum;
 	switch(_jpnevulatorOptions.checksum) {
+		case checksumTypeCrc: {
+			/* The crc engine knows its own size and byte order. */
+			*size+=crcPut(&_jpnevulatorOptions.crc,crcCalculate(&_jpnevulatorOptions.crc,message,*size),&(message[*size]));
+			return;
+		}
 		case checksumTypeCrc8: {
 			checksum=crc8Calculate(message,*size);
 			/* Really dirty trick to put a 0x0D (CR) at the end of the message. But
@@ -62,10 +81,173 @@ static void messageChecksumAdd(unsigned char *message,int *size) {
 	message[(*size)++]=(checksum>>8)&0xFF;
 }
 
+static void messagePrint(unsigned char *message,int size) {
+	int n;
+	for(n=0;n<size;n++) {
+		printf("%02X%c",message[n],n!=(size-1)?' ':'\n');
+	}
+}
+
+/* Print a message that's sent, by the printer thread if we have one. */
+static void messageShow(unsigned char *message,int size) {
+	if(boolIsSet(pipelinePrinting())) {
+		pipelinePrint(message,size);
+	} else {
+		messagePrint(message,size);
+	}
+}
+
+/* Send the message on the line, on the given interface or on all interfaces at
+ * once if none given, or add it to the compiled message file if that's what the
+ * user likes us to do. Every kind of input ends up here, whether text, compiled
+ * or a capture to replay. */
+static void messageSend(struct interface *interface,unsigned char *message,int size,int line,unsigned long *bytesSent) {
+	bool_t printed;
+	boolReset(printed);
+	/* A message that kept us waiting still gets its full delay, unless it's
+	 * replayed at the moment it was captured. */
+	if(boolIsNotSet(_jpnevulatorOptions.replay)) {
+		paceAnchor();
+	}
+	if(_jpnevulatorOptions.compile!=NULL) {
+		if(frameAdd(message,size)!=frameRtrnOk) {
+			fprintf(stderr,"%s: %s: write of line %d failed.\n",PROGRAM_NAME,_jpnevulatorOptions.compile,line);
+		}
+	} else if(boolIsSet(_jpnevulatorOptions.send)) {
+		if(interface==NULL) {
+			/* The writer prints the message once it's really sent, which might
+			 * be together with the ones to come. */
+			writerBatch(message,sizeof(message[0])*size,line);
+			boolSet(printed);
+		} else {
+			writerSend(interface,message,sizeof(message[0])*size,line);
+		}
+		*bytesSent+=size;
+		/* Give the interfaces that are behind a chance to catch up. */
+		queueFlush();
+	}
+
+	/* Print the message if requested. */
+	if(boolIsSet(_jpnevulatorOptions.print)&&boolIsNotSet(printed)) {
+		messageShow(message,size);
+	}
+
+	_stats.messages++;
+	statsPoll(stderr);
+
+	/* Delay between messages if requested. There's no need to wait for a
+	 * compiled message file and a replay keeps the timing of its capture. */
+	if((_jpnevulatorOptions.delayLine>0)&&(_jpnevulatorOptions.compile==NULL)&&boolIsNotSet(_jpnevulatorOptions.replay)) {
+		paceWait(_jpnevulatorOptions.delayLine);
+	}
+}
+
+/* Get the next message from our input, line by line, and add the checksum
+ * if requested. Do leave some room for that checksum. Returns false at the end
+ * of the input or once we have gotten the maximum amount (--count) of bytes,
+ * in which case the last line was cut short. */
+static bool_t messageGet(void *data,unsigned char *message,int *size,int line) {
+	struct byteDecoder *decoder;
+	struct byteLine byteLine;
+	enum byteRtrn rtrn;
+	int n;
+
+	if(_jpnevulatorOptions.count==0) {
+		return(boolFalse);
+	}
+
+	decoder=(struct byteDecoder *)data;
+	byteLine.data=message;
+	byteLine.size=max(0,_jpnevulatorOptions.size-optionsChecksumSize());
+	rtrn=byteLineGet(decoder,&byteLine,_jpnevulatorOptions.count);
+
+	/* Warn the user if we read invalid characters in the input file. We only give a warning and still
+	 * send the message. The user might now what he or she is doing :-) */
+	for(n=0;n<byteLine.unknown;n++) {
+		fprintf(stderr,"%s: invalid characters on input line %d. Message can be corrupted.\n",PROGRAM_NAME,line);
+	}
+	for(n=0;n<byteLine.overflow;n++) {
+		fprintf(stderr,"%s: Input line %d too big. Increase message size (--size).\n",PROGRAM_NAME,line);
+	}
+
+	/* A last line without an end-of-line is never sent. */
+	if(rtrn==byteRtrnEOF) {
+		return(boolFalse);
+	}
+
+	/* Do we count the amount of bytes to write? */
+	if(_jpnevulatorOptions.count>0) {
+		_jpnevulatorOptions.count-=byteLine.length+byteLine.overflow;
+	}
+
+	/* Add a checksum to the message if requested. */
+	*size=byteLine.length;
+	if(_jpnevulatorOptions.checksum!=checksumTypeNone) {
+		messageChecksumAdd(message,size);
+		if(boolIsSet(_jpnevulatorOptions.checksumFuckup)) {
+			/* Subtract one from the last checksum byte of the message if the user
+			 * request to fuck up the checksum. */
+			message[*size-1]-=1;
+		}
+	}
+	return(boolTrue);
+}
+
+static void messagesText(struct byteDecoder *decoder,unsigned char *message,unsigned long *bytesSent) {
+	int size;
+	int line;
+	/* Whatever is batched goes out before we wait for more input. And a report
+	 * that is asked for doesn't wait for it either. */
+	decoder->idle=writerFlush;
+	decoder->watchFd=statsFd();
+	decoder->watch=statsNotified;
+	for(line=1;boolIsSet(messageGet(decoder,message,&size,line));line++) {
+		messageSend(NULL,message,size,line,bytesSent);
+	}
+}
+
+/* The same, but the messages come from our parser thread. */
+static void messagesPipelined(unsigned long *bytesSent) {
+	unsigned char *message;
+	int size;
+	int line;
+	while(boolIsSet(pipelineNext(&message,&size,&line))) {
+		messageSend(NULL,message,size,line,bytesSent);
+		pipelineDone();
+	}
+}
+
+/* Send the messages of a compiled message file. They are complete already, so
+ * they go out straight from the map. */
+static void messagesCompiled(unsigned long *bytesSent) {
+	unsigned char *message;
+	enum frameRtrn rtrn;
+	int size;
+	int line;
+	for(line=1;(_jpnevulatorOptions.count!=0)&&((rtrn=frameNext(&message,&size))==frameRtrnOk);line++) {
+		/* Do we count the amount of bytes to write? */
+		if(_jpnevulatorOptions.count>0) {
+			size=min(size,_jpnevulatorOptions.count);
+			_jpnevulatorOptions.count-=size;
+		}
+		messageSend(NULL,message,size,line,bytesSent);
+	}
+	if((_jpnevulatorOptions.count!=0)&&(rtrn==frameRtrnFormat)) {
+		fprintf(stderr,"%s: Compiled message file truncated after message %d.\n",PROGRAM_NAME,line-1);
+	}
+}
+
 /* Nice way of leaving no traces...
  * ...the more we know, the more we return. */
 #define jpnevulatorGarbageCollect() { \
+	statsDestroy(); \
+	pipelineStop(); \
+	frameClose(); \
+	frameUnmap(); \
+	writerDestroy(); \
+	queueDestroy(); \
 	interfaceDestroy(); \
+	byteDecoderDestroy(&decoder); \
 	if(input!=NULL) { \
 		ioClose(input); \
 	} \
@@ -74,13 +256,13 @@ static void messageChecksumAdd(unsigned char *message,int *size) {
 	} \
 }
 enum jpnevulatorRtrn jpnevulatorWrite(void) {
-	int byte; 
-	struct interface *interface;
 	FILE *input=NULL;
 	unsigned char *message=NULL;
-	int index;
-	int line;
-	bool_t writingStart;
+	struct byteDecoder decoder;
+	enum frameRtrn compiled;
+	unsigned long bytesSent=0UL;
+
+	decoder.buffer=NULL;
 
 	/* Open our input file. */
 	input=ioOpen("r");
@@ -90,6 +272,23 @@ enum jpnevulatorRtrn jpnevulatorWrite(void) {
 		return(jpnevulatorRtrnNoInput);
 	}
 
+	/* Is our input a compiled message file? */
+	compiled=frameMap(fileno(input));
+	if((compiled!=frameRtrnOk)&&(compiled!=frameRtrnNone)) {
+		fprintf(stderr,"%s: Unable to use the compiled message file, %s.\n",PROGRAM_NAME,compiled==frameRtrnFormat?"unsupported version or byte order":"can't map it");
+		jpnevulatorGarbageCollect();
+		return(jpnevulatorRtrnNoInput);
+	}
+
+	/* Or should we compile one? */
+	if(_jpnevulatorOptions.compile!=NULL) {
+		if(frameCreate(_jpnevulatorOptions.compile)!=frameRtrnOk) {
+			perror(PROGRAM_NAME": Unable to create the compiled message file");
+			jpnevulatorGarbageCollect();
+			return(jpnevulatorRtrnNoOutput);
+		}
+	}
+
 	/* Allocate memory for the messages to send. */
 	message=(unsigned char *)malloc(sizeof(message[0])*_jpnevulatorOptions.size);
 	if(message==NULL) {
@@ -98,103 +297,74 @@ enum jpnevulatorRtrn jpnevulatorWrite(void) {
 		return(jpnevulatorRtrnNoMessage);
 	}
 
-	/* By default we do not expect to start writing because we have reached the
-	 * maximum amount (--count) of bytes. */
-	boolReset(writingStart);
-
-	/* Collect and send the messages. We collect the messages byte by byte from the
-	 * input and send them on the line when we receive an end-of-line. Take notice
-	 * of this rather strange test. We need to test for writingStart too, since it's
-	 * possible the counter equals zero and we still need to write some bytes on the
-	 * line. I myself will probably not understand why within a couple of months, hence
-	 * this special remark. Not too many details, since I like to keep myself puzzeled
-	 * every once in a while. ;) */
-	line=1;
-	for(index=0;(boolIsSet(writingStart)||(_jpnevulatorOptions.count!=0))&&((byte=byteGet(input,_jpnevulatorOptions.base))!=byteRtrnEOF);) {
-		if(boolIsSet(writingStart)) {
-			byte=byteRtrnEOL;
-		}
-		switch(byte) {
-			case byteRtrnEOL: {
-				int n;
-
-				/* Add a checksum to the message if requested. */
-				if(_jpnevulatorOptions.checksum!=checksumTypeNone) {
-					messageChecksumAdd(message,&index);
-					if(boolIsSet(_jpnevulatorOptions.checksumFuckup)) {
-						/* Subtract one from the last checksum byte of the message if the user
-						 * request to fuck up the checksum. */
-						message[index-1]-=1;
-					}
-				}
+	/* Our input is decoded in big blocks, not byte by byte. */
+	if(byteDecoderInitialize(&decoder,fileno(input),_jpnevulatorOptions.base,_jpnevulatorOptions.bufferSize)!=byteDecoderRtrnOk) {
+		perror(PROGRAM_NAME": Unable to allocate memory for the input");
+		jpnevulatorGarbageCollect();
+		return(jpnevulatorRtrnNoInput);
+	}
 
-				/* Send the message on the line. */
-				if(boolIsSet(_jpnevulatorOptions.send)) {
-					if((interface=(struct interface *)listFirst(&_jpnevulatorOptions.interface))!=NULL) {
-						do {
-							/* Delay between bytes if requested. */
-							if(_jpnevulatorOptions.delayByte>0) {
-								int byteIndex;
-								for(byteIndex=0;byteIndex<index;byteIndex++) {
-									n=write(interface->fd,&(message[byteIndex]),1);
-									if(n<0) {
-										fprintf(stderr,"%s: %s: write of line %d byte %d failed(%d).\n",PROGRAM_NAME,interfacePrint(interface),line,byteIndex,n);
-									}
-									usleep(_jpnevulatorOptions.delayByte);
-								}
-							} else {
-								n=write(interface->fd,message,sizeof(message[0])*index);
-								if(n<0) {
-									fprintf(stderr,"%s: %s: write of line %d failed(%d).\n",PROGRAM_NAME,interfacePrint(interface),line,n);
-								}
-							}
-						} while((interface=(struct interface *)listNext(&_jpnevulatorOptions.interface))!=NULL);
-					}
-				}
+	/* A slow interface should not hold back the others, so whatever it can't take
+	 * right away waits in its own queue. */
+	if(queueInitialize(boolFalse)!=queueRtrnOk) {
+		perror(PROGRAM_NAME": Unable to allocate memory for the output queues");
+		jpnevulatorGarbageCollect();
+		return(jpnevulatorRtrnNoMessage);
+	}
+	if(writerInitialize(boolIsSet(_jpnevulatorOptions.print)?messageShow:NULL)!=writerRtrnOk) {
+		perror(PROGRAM_NAME": Unable to allocate memory for the writers");
+		jpnevulatorGarbageCollect();
+		return(jpnevulatorRtrnNoMessage);
+	}
 
-				/* Print the message if requested. */
-				if(boolIsSet(_jpnevulatorOptions.print)) {
-					for(n=0;n<index;n++) {
-						printf("%02X%c",message[n],n!=(index-1)?' ':'\n');
-					}
-				}
+	/* From now on all our delays are counted, and everything else too. */
+	paceInitialize();
+	if(statsInitialize()!=statsRtrnOk) {
+		perror(PROGRAM_NAME": Unable to start keeping statistics");
+		jpnevulatorGarbageCollect();
+		return(jpnevulatorRtrnNoMessage);
+	}
 
-				/* Delay between messages if requested. */
-				if(_jpnevulatorOptions.delayLine>0) {
-					usleep(_jpnevulatorOptions.delayLine);
-				}
+	if(compiled==frameRtrnOk) {
+		messagesCompiled(&bytesSent);
+	} else if(boolIsSet(_jpnevulatorOptions.replay)) {
+		/* A capture of ours is replayed the way it was captured. */
+		if(replayRun(input,messageSend,&bytesSent)!=replayRtrnOk) {
+			perror(PROGRAM_NAME": Unable to allocate memory for the replay");
+			jpnevulatorGarbageCollect();
+			return(jpnevulatorRtrnNoMessage);
+		}
+	} else if(boolIsSet(_jpnevulatorOptions.thread)) {
+		/* Parse, send and print, all at the same time. */
+		pipelineWatch(statsFd(),statsNotified);
+		if(pipelineStart(messageGet,&decoder,writerFlush,boolIsSet(_jpnevulatorOptions.print)?messagePrint:NULL)!=pipelineRtrnOk) {
+			perror(PROGRAM_NAME": Unable to start the pipeline");
+			jpnevulatorGarbageCollect();
+			return(jpnevulatorRtrnNoMessage);
+		}
+		messagesPipelined(&bytesSent);
+		pipelineStop();
+	} else {
+		messagesText(&decoder,message,&bytesSent);
+	}
 
-				/* Make sure this is reset again, otherwise we will never stop reading from stdin even though we have
-				 * already refused to write more data. :) */
-				boolReset(writingStart);
+	/* Don't leave before everything is on the line. */
+	writerFlush();
+	queueDrain();
+	writerDrain();
+	queueReport(stderr);
+	writerReport(stderr);
+	paceReport(stderr,bytesSent);
+	if(boolIsSet(_jpnevulatorOptions.statistics)) {
+		statsReport(stderr);
+	}
+	statsExport();
 
-				/* Start again with a new message and increase the line counter. */
-				index=0;
-				line++;
-				break;
-			}
-			case byteRtrnUnknown: {
-				/* Warn the user if we read invalid characters in the input file. We only give a warning and still
-				 * send the message. The user might now what he or she is doing :-) */
-				fprintf(stderr,"%s: invalid characters on input line %d. Message can be corrupted.\n",PROGRAM_NAME,line);
-				break;
-			}
-			default: {
-				/* Place the new input byte into the message. Check if there is enough room for
-				 * this new byte and do leave some room(2 bytes) for the checksum if necessary.
-				 * Nice trick ;-) */
-				if(index<(_jpnevulatorOptions.size-(_jpnevulatorOptions.checksum*2))) {
-					message[index++]=byte;
-				} else {
-					fprintf(stderr,"%s: Input line %d too big. Increase message size (--size).\n",PROGRAM_NAME,line);
-				}
-				/* Do we count the amount of bytes to write and if so are we finished writing? */
-				if((_jpnevulatorOptions.count>0)&&(--_jpnevulatorOptions.count==0)) {
-					boolSet(writingStart);
-				}
-				break;
-			}
-		}
+	/* Our compiled message file is only complete once closed. */
+	if(frameClose()!=frameRtrnOk) {
+		perror(PROGRAM_NAME": Unable to write the compiled message file");
+		jpnevulatorGarbageCollect();
+		return(jpnevulatorRtrnNoOutput);
 	}
 
 	/* Free allocated memory and close files opened. */
@@ -204,137 +374,266 @@ enum jpnevulatorRtrn jpnevulatorWrite(void) {
 }
 #undef jpnevulatorGarbageCollect
 
-static void asciiWrite(FILE *output,char *ascii,int asciiSize,int *bytesWritten,bool_t fill) {
-	if((*bytesWritten)!=0) {
-		if(boolIsSet(_jpnevulatorOptions.ascii)) {
-			if(boolIsSet(fill)) {
-				int index;
-				for(index=*bytesWritten;index<_jpnevulatorOptions.width;index++) {
-					switch(_jpnevulatorOptions.base) {
-#define BASE(base,name,width) \
-						case name: { \
-							fprintf(output,"%s",SPACES(width+1)); \
-							break; \
-						}
-						BASES
-#undef BASE
-					}
-				}
-			}
-			fprintf(output,"\t%s",ascii);
-			memset(ascii,'\0',asciiSize);
-		}
-		fprintf(output,"\n");
-		*bytesWritten=0;
-	}
-}
-
 static void headerWrite(
 	FILE *output,
-	char *ascii,int asciiSize,
-	int *bytesWritten,
-	struct interface *interfaceReader,char *interfaceNameCopy,int interfaceNameCopySize,
-	struct timeval *timeCurrent,struct timeval *timeLast
+	struct interface *interfaceReader,int *interfaceLast,
+	struct timestamp *timeCurrent,struct timestamp *timeLast,struct timestamp *timeNow
 ) {
-	struct tm *time;
 	*timeLast=*timeCurrent;
-	gettimeofday(timeCurrent,NULL);
+	*timeCurrent=*timeNow;
 	if(
 		boolIsSet(_jpnevulatorOptions.timingPrint)&&
-		((memcmp(interfaceNameCopy,interfaceReader->name,interfaceNameCopySize)!=0)||
-		(((((timeCurrent->tv_sec-timeLast->tv_sec)*1000000L)+timeCurrent->tv_usec)-timeLast->tv_usec)>_jpnevulatorOptions.timingDelta))
+		((*interfaceLast!=interfaceReader->id)||
+		(timestampDiff(timeCurrent,timeLast)>(long long)_jpnevulatorOptions.timingDelta*1000LL))
 	) {
-		asciiWrite(output,ascii,asciiSize,bytesWritten,boolTrue);
-		time=localtime(&(timeCurrent->tv_sec));
-		fprintf(
-			output,
-			"%04d-%02d-%02d %02d:%02d:%02d.%06ld:",
-			time->tm_year+1900,time->tm_mon+1,time->tm_mday,
-			time->tm_hour,time->tm_min,time->tm_sec,timeCurrent->tv_usec
-		);
+		char time[TIMESTAMP_LENGTH];
+		int length;
+		formatLineEnd(boolTrue);
+		length=timestampFormat(timeCurrent,time);
+		time[length++]=':';
+		fwrite(time,1,length,output);
 		/* If more than one interface is given we want it always to
 		 * be displayed as part of the printing of the timing. It's
 		 * way to confusing otherwise. */
-		if(listElements(&_jpnevulatorOptions.interface)>1) {
+		if(interfaceCount()>1) {
 			fprintf(output," %s",interfacePrint(interfaceReader));
 		}
-		memcpy(interfaceNameCopy,interfaceReader->name,interfaceNameCopySize);
-		fprintf(output,"\n");
+		*interfaceLast=interfaceReader->id;
+		fputc('\n',output);
 	} else {
 		if(
-			(listElements(&_jpnevulatorOptions.interface)>1)&&
-			(memcmp(interfaceNameCopy,interfaceReader->name,interfaceNameCopySize)!=0)
+			(interfaceCount()>1)&&
+			(*interfaceLast!=interfaceReader->id)
 		) {
-			asciiWrite(output,ascii,asciiSize,bytesWritten,boolTrue);
+			formatLineEnd(boolTrue);
 			fprintf(output,"%s\n",interfacePrint(interfaceReader));
-			memcpy(interfaceNameCopy,interfaceReader->name,interfaceNameCopySize);
+			*interfaceLast=interfaceReader->id;
 		}
 	}
 }
 
+/* Show the new modem control bits of the given interface. */
+static void controlShow(
+	FILE *output,
+	struct interface *interfaceReader,int *interfaceLast,
+	struct timestamp *timeCurrent,struct timestamp *timeLast,struct timestamp *timeNow,
+	int control
+) {
+	/* We need this explicit call to formatLineEnd, even though headerWrite will call formatLineEnd() itself probably. Yes, the probably
+	 * means exactly what it says probably. It's possible that controlHandle() gets called and headerWrite() does not think it
+	 * needs to write a new header and so no need to write the ascii data, but new control data will get written before the ascii
+	 * data is written. That is, if the modem control bits change within the timing delta on an interface that has just received
+	 * data. Blam, nasty output! This explicit call to formatLineEnd() fixes that. */
+	formatLineEnd(boolTrue);
+	headerWrite(output,interfaceReader,interfaceLast,timeCurrent,timeLast,timeNow);
+	interfaceControlWrite(interfaceReader,output,control);
+}
+
 static void controlHandle(
 	FILE *output,
-	char *ascii,int asciiSize,
-	int *bytesWritten,
-	struct interface *interfaceReader,char *interfaceNameCopy,int interfaceNameCopySize,
-	struct timeval *timeCurrent,struct timeval *timeLast
+	struct interface *interfaceReader,int *interfaceLast,
+	struct timestamp *timeCurrent,struct timestamp *timeLast
 ) {
 	int control;
+	/* An interface that tells us about its changes by itself has got no need to be polled. */
+	if(interfaceReader->controlWait!=NULL) {
+		return;
+	}
 	control=interfaceControlGet(interfaceReader);
 	if(control!=interfaceReader->control) {
-		/* We need this explicit call to asciiWrite, even though headerWrite will call asciiWrite() itself probably. Yes, the probably
-		 * means exactly what it says probably. It's possible that controlHandle() gets called and headerWrite() does not think it
-		 * needs to write a new header and so no need to write the ascii data, but new control data will get written before the ascii
-		 * data is written. That is, if the modem control bits change within the timing delta on an interface that has just received
-		 * data. Blam, nasty output! This explicit call to asciiWrite() fixes that. */
-		asciiWrite(output,ascii,asciiSize,bytesWritten,boolTrue);
-		headerWrite(output,ascii,asciiSize,bytesWritten,interfaceReader,interfaceNameCopy,interfaceNameCopySize,timeCurrent,timeLast);
-		interfaceControlWrite(interfaceReader,output,control);
+		struct timestamp timeNow;
+		timestampGet(&timeNow);
+		if(_jpnevulatorOptions.captureFormat==captureFormatBinary) {
+			captureControl(interfaceReader,&timeNow,control);
+		} else {
+			controlShow(output,interfaceReader,interfaceLast,timeCurrent,timeLast,&timeNow,control);
+		}
 		interfaceReader->control=control;
 	}
 }
 
+/* The state of our reader. Every interface gets its own call-back from the reactor,
+ * so whatever used to live on the stack of jpnevulatorRead() needs to live here. */
+static struct {
+	FILE *output;
+	unsigned char *message;
+	/* The id of the interface we displayed last. */
+	int interfaceLast;
+	struct timestamp timeCurrent,timeLast;
+} _reader;
+
+/* Called by the reactor every time a monitor tells us the modem control bits of an
+ * interface changed. */
+static void controlChanged(struct interface *interfaceReader,struct timestamp *timeNow,int control) {
+	if(control!=interfaceReader->control) {
+		if(_jpnevulatorOptions.captureFormat==captureFormatBinary) {
+			captureControl(interfaceReader,timeNow,control);
+		} else {
+			controlShow(_reader.output,interfaceReader,&_reader.interfaceLast,&_reader.timeCurrent,&_reader.timeLast,timeNow,control);
+		}
+		interfaceReader->control=control;
+		fflush(_reader.output);
+	}
+}
+
+/* Is there any interface left whose modem control bits need to be polled? */
+static bool_t controlPolled(void) {
+	int id;
+	if(boolIsSet(_jpnevulatorOptions.control)) {
+		for(id=0;id<interfaceCount();id++) {
+			if(interfaceGet(id)->controlWait==NULL) {
+				return(boolTrue);
+			}
+		}
+	}
+	return(boolFalse);
+}
+
+/* Display a chunk of bytes read from the given interface at the given time. Returns
+ * the amount of bytes displayed, which might be less than given if we reach the
+ * amount of bytes we were asked for. */
+static ssize_t chunkShow(struct interface *interfaceReader,struct timestamp *timeRead,unsigned char *message,ssize_t bytesRead) {
+	/* Another interface might already have given us all the bytes we were asked for. And
+	 * a reader thread does not know about --count at all, so it might have given us too
+	 * many. */
+	if(_jpnevulatorOptions.count==0) {
+		return(0);
+	}
+	if((_jpnevulatorOptions.count>0)&&(bytesRead>_jpnevulatorOptions.count)) {
+		bytesRead=_jpnevulatorOptions.count;
+	}
+	/* Are we counting bytes and if so subtract the amount just read. */
+	if(_jpnevulatorOptions.count>0) {
+		_jpnevulatorOptions.count-=bytesRead;
+	}
+	if(_jpnevulatorOptions.captureFormat==captureFormatBinary) {
+		/* No formatting at all, just store the bytes as they are. */
+		captureData(interfaceReader,timeRead,message,bytesRead);
+	} else {
+		struct timestamp timeStarted,timeFormatted;
+		/* The bytes might have been read quite a while ago by a reader thread,
+		 * so only count the time it takes us to get them out. */
+		timestampGet(&timeStarted);
+		headerWrite(_reader.output,interfaceReader,&_reader.interfaceLast,&_reader.timeCurrent,&_reader.timeLast,timeRead);
+		formatBytes(interfaceReader,message,bytesRead);
+		timestampGet(&timeFormatted);
+		_stats.formatTime+=timestampDiff(&timeFormatted,&timeStarted);
+	}
+	_stats.chunks++;
+	return(bytesRead);
+}
+
+/* Display a chunk of bytes read by a reader thread and pass it on to the other
+ * interfaces if requested. */
+static void chunkHandle(struct interface *interfaceReader,struct timestamp *timeRead,unsigned char *message,ssize_t bytesRead) {
+	statsRead(interfaceReader,timeRead,bytesRead);
+	bytesRead=chunkShow(interfaceReader,timeRead,message,bytesRead);
+	/* Does the user want to pass the data between all the interfaces? */
+	if(boolIsSet(_jpnevulatorOptions.pass)&&(bytesRead>0)) {
+		forwardWrite(interfaceReader,message,bytesRead);
+	}
+	fflush(_reader.output);
+}
+
+/* Called by the reactor every time an interface has got something for us. */
+static void interfaceReadable(void *data) {
+	struct interface *interfaceReader;
+	struct timestamp timeRead;
+	ssize_t bytesRead;
+	int size;
+	interfaceReader=(struct interface *)data;
+	/* Another interface that became readable at the very same moment might already
+	 * have given us all the bytes we were asked for. */
+	if(_jpnevulatorOptions.count==0) {
+		return;
+	}
+	/* How many bytes should we read? */
+	if((_jpnevulatorOptions.count>0)&&(_jpnevulatorOptions.count<_jpnevulatorOptions.bufferSize)) {
+		/* We need less bytes than the input buffer can handle, so only take what needed. */
+		size=_jpnevulatorOptions.count;
+	} else {
+		/* Take as many as possible. No limit set or not yet within reach. */
+		size=_jpnevulatorOptions.bufferSize;
+	}
+	/* Does the user want to pass the data between all the interfaces? In that case
+	 * the bytes are passed on before we even look at them. */
+	if(boolIsSet(_jpnevulatorOptions.pass)) {
+		bytesRead=forwardRead(interfaceReader,_reader.message,size);
+	} else {
+		bytesRead=read(interfaceReader->fd,_reader.message,size);
+	}
+	if(bytesRead>0) {
+		timestampGet(&timeRead);
+		statsRead(interfaceReader,&timeRead,bytesRead);
+		chunkShow(interfaceReader,&timeRead,_reader.message,bytesRead);
+		fflush(_reader.output);
+	}
+}
+
+/* What timeout shall we use in read mode? If only one of --ascii and polling for
+ * the modem control bits is needed use that one and otherwise use the smallest of
+ * the two. The ASCII data gets written once more than timeoutDelta timeouts in a
+ * row happened. If neither is needed we do not need a timeout at all. */
+static bool_t timeoutSelect(unsigned long **timeoutReference,int *timeoutDelta,bool_t control) {
+	*timeoutDelta=0;
+	if(boolIsSet(_jpnevulatorOptions.ascii)&&boolIsSet(control)) {
+		if(_jpnevulatorOptions.timingDelta<_jpnevulatorOptions.controlPoll) {
+			*timeoutReference=&_jpnevulatorOptions.timingDelta;
+			*timeoutDelta=(_jpnevulatorOptions.controlPoll/_jpnevulatorOptions.timingDelta)+1;
+		} else {
+			*timeoutReference=&_jpnevulatorOptions.controlPoll;
+			*timeoutDelta=(_jpnevulatorOptions.timingDelta/_jpnevulatorOptions.controlPoll)+1;
+		}
+	} else if(boolIsSet(_jpnevulatorOptions.ascii)) {
+		*timeoutReference=&_jpnevulatorOptions.timingDelta;
+	} else if(boolIsSet(control)) {
+		*timeoutReference=&_jpnevulatorOptions.controlPoll;
+	} else {
+		return(boolFalse);
+	}
+	return(boolTrue);
+}
+
 /* Nice way of leaving no traces...
  * ...the more we know, the more we return. */
 #define jpnevulatorGarbageCollect() { \
+	statsDestroy(); \
+	monitorStop(); \
+	readerStop(); \
+	forwardDestroy(); \
+	queueDestroy(); \
+	reactorDestroy(); \
 	interfaceDestroy(); \
-	if(output!=NULL) { \
-		ioClose(output); \
-	} \
-	if(message!=NULL) { \
-		free(message); \
+	if(_reader.output!=NULL) { \
+		ioClose(_reader.output); \
 	} \
-	if(ascii!=NULL) { \
-		free(ascii); \
+	if(_reader.message!=NULL) { \
+		free(_reader.message); \
 	} \
+	formatDestroy(); \
+	captureDestroy(); \
 }
 enum jpnevulatorRtrn jpnevulatorRead(void) {
-	FILE *output=NULL;
-	unsigned char *message=NULL;
-	char *ascii=NULL;
-	int asciiSize;
-	ssize_t bytesRead;
-	int bytesWritten;
-	struct timeval timeCurrent,timeLast,*timeoutPtr,timeout;
+	unsigned long *timeoutPtr,timeout;
 	unsigned long *timeoutReference;
 	int timeoutDelta,timeoutCount;
-	fd_set readfdsReal,readfdsCopy;
-	struct interface *interfaceReader,*interfaceWriter;
-	char interfaceNameCopy[sizeof(interfaceReader->name)];
-	int nfds;
+	struct interface *interfaceReader;
+	int id;
+
+	_reader.message=NULL;
 
 	/* Open our output file. */
-	output=ioOpen(boolIsSet(_jpnevulatorOptions.append)?"a":"w");
-	if(output==NULL) {
+	_reader.output=ioOpen(boolIsSet(_jpnevulatorOptions.append)?"a":"w");
+	if(_reader.output==NULL) {
 		perror(PROGRAM_NAME": Unable to open output");
 		jpnevulatorGarbageCollect();
 		return(jpnevulatorRtrnNoOutput);
 	}
 	/* In append mode we first check if the file is empty. If not we
 	 * first append the given append separator. */
-	if(boolIsSet(_jpnevulatorOptions.append)) {
+	if(boolIsSet(_jpnevulatorOptions.append)&&(_jpnevulatorOptions.captureFormat==captureFormatText)) {
 		struct stat outputStat;
-		fstat(fileno(output),&outputStat);
+		fstat(fileno(_reader.output),&outputStat);
 		if(outputStat.st_size>0) {
 			char *index;
 			/* We need to parse the append separator a little bit and search for
@@ -342,71 +641,125 @@ enum jpnevulatorRtrn jpnevulatorRead(void) {
 			 * character in place. */
 			for(index=_jpnevulatorOptions.appendSeparator;*index!='\0';index++) {
 				if((*index=='\\')&&(*(index+1)=='n')) {
-					fprintf(output,"\n");
+					fprintf(_reader.output,"\n");
 					index++;
 				} else {
-					fprintf(output,"%c",*index);
+					fprintf(_reader.output,"%c",*index);
 				}
 					
 			}
 		}
 	}
 
-	/* Allocate memory for the messages to receive. */
-	message=(unsigned char *)malloc(sizeof(message[0])*_jpnevulatorOptions.size);
-	if(message==NULL) {
+	/* Allocate memory for the data to receive. This is our capture buffer, so it's sized by
+	 * --buffer-size and not by --size, which only makes sense for the messages we write. */
+	_reader.message=(unsigned char *)malloc(sizeof(_reader.message[0])*_jpnevulatorOptions.bufferSize);
+	if(_reader.message==NULL) {
 		perror(PROGRAM_NAME": Unable to allocate memory for message");
 		jpnevulatorGarbageCollect();
 		return(jpnevulatorRtrnNoMessage);
 	}
 
-	/* Allocate memory for the ascii data to print if desired. */
-	if(boolIsSet(_jpnevulatorOptions.ascii)) {
-		asciiSize=(sizeof(ascii[0])*_jpnevulatorOptions.width)+1;
-		ascii=(char *)malloc(asciiSize);
-		if(ascii==NULL) {
-			perror(PROGRAM_NAME": Unable to allocate memory for ascii data");
+	/* Prepare our line formatter, including the memory for the ascii data to print if desired. */
+	if(formatInitialize(_reader.output)!=formatRtrnOk) {
+		perror(PROGRAM_NAME": Unable to allocate memory for the output lines");
+		jpnevulatorGarbageCollect();
+		return(jpnevulatorRtrnNoAscii);
+	}
+
+	/* A binary capture starts with the description of all our interfaces. */
+	if(_jpnevulatorOptions.captureFormat==captureFormatBinary) {
+		if(captureInitialize(_reader.output)!=captureRtrnOk) {
+			perror(PROGRAM_NAME": Unable to write the capture header");
 			jpnevulatorGarbageCollect();
-			return(jpnevulatorRtrnNoAscii);
+			return(jpnevulatorRtrnNoOutput);
 		}
-		memset(ascii,'\0',asciiSize);
-	} else {
-		/* No real reason to do this, but it makes the compiler happy. If this next line is not
-		 * here the compiler generates this warning below:
-		 *
-		 * jpnevulator.c:407:19: warning: ‘asciiSize’ may be used uninitialized in this function [-Wuninitialized]
-		 *
-		 * So let's initialize asciiSize anyway. */
-		asciiSize=0;
 	}
 
 	/* Initialize our last time to be far enough from the current time. Far
 	 * enough is a little bit more than --timing-delta away from it. This way
 	 * our first data will always gets it's timing information if requested. Take
 	 * notice that I use timeCurrent here, since that one will be assigned to
-	 * timeLast before gettimeofday() in the loop. */
-	gettimeofday(&timeCurrent,NULL);
-	timeCurrent.tv_sec-=(_jpnevulatorOptions.timingDelta/1000000L)+1;
-
-	/* Setup our set of read file descriptors to watch. We set up the copy
-	 * so we don't have to parse our list of interfaces every time we iterate. */
-	FD_ZERO(&readfdsCopy);
-	nfds=0;
-	if((interfaceReader=(struct interface *)listFirst(&_jpnevulatorOptions.interface))!=NULL) {
-		do {
-			FD_SET(interfaceReader->fd,&readfdsCopy);
-			nfds=max(nfds,interfaceReader->fd);
-		} while((interfaceReader=(struct interface *)listNext(&_jpnevulatorOptions.interface))!=NULL);
-	} else {
+	 * timeLast before the first header is written. Only the monotonic clock is
+	 * taken into account for the timing delta, so we leave the other alone. */
+	timestampInitialize(_jpnevulatorOptions.timingStyle,NULL);
+	timestampGet(&_reader.timeCurrent);
+	_reader.timeCurrent.monotonic.tv_sec-=(_jpnevulatorOptions.timingDelta/1000000L)+1;
+
+	/* Hand all our interfaces over to the reactor. From now on it will call us
+	 * back for every interface that has something to say, no matter how many
+	 * of them are silent. */
+	if(reactorInitialize()!=reactorRtrnOk) {
+		perror(PROGRAM_NAME": Unable to create the reactor");
+		jpnevulatorGarbageCollect();
+		return(jpnevulatorRtrnNoTTY);
+	}
+	if(interfaceCount()==0) {
 		fprintf(stderr,"%s: No available interface to read from\n",PROGRAM_NAME);
 		jpnevulatorGarbageCollect();
 		return(jpnevulatorRtrnNoTTY);
 	}
+	/* Passing data between the interfaces is done inside the kernel as much as
+	 * possible. The reader threads read the data themselves, so there we simply
+	 * write what they have read. An interface that can't keep up gets its bytes
+	 * queued, the reactor tells us when it's ready for more. */
+	if(boolIsSet(_jpnevulatorOptions.pass)) {
+		if(queueInitialize(boolTrue)!=queueRtrnOk) {
+			perror(PROGRAM_NAME": Unable to allocate memory for the output queues");
+			jpnevulatorGarbageCollect();
+			return(jpnevulatorRtrnNoMessage);
+		}
+		if(forwardInitialize(boolIsNotSet(_jpnevulatorOptions.thread))!=forwardRtrnOk) {
+			perror(PROGRAM_NAME": Unable to prepare passing data between the interfaces");
+			jpnevulatorGarbageCollect();
+			return(jpnevulatorRtrnNoTTY);
+		}
+	}
+	/* Keep count of what goes in and out of every interface. A SIGUSR1 tells
+	 * us to show what we have counted so far, the reactor tells us about it. */
+	if(
+		(statsInitialize()!=statsRtrnOk)||
+		(reactorAdd(statsFd(),statsNotified,NULL,NULL)!=reactorRtrnOk)
+	) {
+		perror(PROGRAM_NAME": Unable to start keeping statistics");
+		jpnevulatorGarbageCollect();
+		return(jpnevulatorRtrnNoMessage);
+	}
+	if(boolIsSet(_jpnevulatorOptions.thread)) {
+		/* Every interface gets a reader thread of its own. They hand us their chunks
+		 * through the reactor, in the order they were read. */
+		if(readerStart(chunkHandle)!=readerRtrnOk) {
+			perror(PROGRAM_NAME": Unable to start the reader threads");
+			jpnevulatorGarbageCollect();
+			return(jpnevulatorRtrnNoTTY);
+		}
+	} else {
+		for(id=0;id<interfaceCount();id++) {
+			interfaceReader=interfaceGet(id);
+			if(reactorAdd(interfaceReader->fd,interfaceReadable,(void *)interfaceReader,&interfaceReader->reactor)!=reactorRtrnOk) {
+				char error[1024];
+				snprintf(error,sizeof(error)-1,"%s: Unable to watch interface %s",PROGRAM_NAME,interfacePrint(interfaceReader));
+				perror(error);
+				jpnevulatorGarbageCollect();
+				return(jpnevulatorRtrnNoTTY);
+			}
+		}
+	}
+
+	/* The interfaces able to tell us about changes of their modem control bits get
+	 * a monitor of their own, so they don't need to be polled. */
+	if(boolIsSet(_jpnevulatorOptions.control)) {
+		if(monitorStart(controlChanged)!=monitorRtrnOk) {
+			perror(PROGRAM_NAME": Unable to start the modem control monitors");
+			jpnevulatorGarbageCollect();
+			return(jpnevulatorRtrnNoTTY);
+		}
+	}
 
 	/* Clear our copy of the interface name, so if multiple interfaces are
 	 * given it will print the first one and only on a change the name
 	 * of the interface will be printed. */
-	memset(interfaceNameCopy,'\0',sizeof(interfaceNameCopy));
+	_reader.interfaceLast=-1;
 
 	/* Do we need a timeout? We only need this when we also display the ASCII
 	 * values for the received bytes. In that case we use the timeout to display
@@ -415,40 +768,23 @@ enum jpnevulatorRtrn jpnevulatorRead(void) {
 	 *
 	 * And of course we need the timeout too when we poll for modem control bits. */
 	timeoutCount=0;
-	timeoutDelta=0;
-	if(boolIsSet(_jpnevulatorOptions.ascii)||boolIsSet(_jpnevulatorOptions.control)) {
+	if(timeoutSelect(&timeoutReference,&timeoutDelta,controlPolled())) {
 		timeoutPtr=&timeout;
-		/* What timeout shall we use? If only one of the two is activated use
-		 * that one and otherwise use the smallest of the two. */
-		if(boolIsSet(_jpnevulatorOptions.ascii)&&boolIsSet(_jpnevulatorOptions.control)) {
-			if(_jpnevulatorOptions.timingDelta<_jpnevulatorOptions.controlPoll) {
-				timeoutReference=&_jpnevulatorOptions.timingDelta;
-				timeoutDelta=(_jpnevulatorOptions.controlPoll/_jpnevulatorOptions.timingDelta)+1;
-			} else {
-				timeoutReference=&_jpnevulatorOptions.controlPoll;
-				timeoutDelta=(_jpnevulatorOptions.timingDelta/_jpnevulatorOptions.controlPoll)+1;
-			}
-		} else if(boolIsSet(_jpnevulatorOptions.ascii)) {
-			timeoutReference=&_jpnevulatorOptions.timingDelta;
-		} else {
-			timeoutReference=&_jpnevulatorOptions.controlPoll;
-		}
 	} else {
 		timeoutPtr=NULL;
 	}
 	/* Receive our messages. */
-	bytesWritten=0;
 	for(;_jpnevulatorOptions.count!=0;) {
-		int index;
 		int rtrn;
-		/* Restore our set of read file descriptors. */
-		readfdsReal=readfdsCopy;
 		if(timeoutPtr!=NULL) {
-			timeoutPtr->tv_sec=(*timeoutReference)/1000000L;
-			timeoutPtr->tv_usec=(*timeoutReference)%1000000L;
+			*timeoutPtr=*timeoutReference;
+		}
+		/* Wait and see if anything flows in. The reactor calls interfaceReadable()
+		 * for every interface that has data available. */
+		rtrn=reactorWait(timeoutPtr);
+		if(rtrn>0) {
+			_stats.wakeups++;
 		}
-		/* Wait and see if anything flows in. */
-		rtrn=select(nfds+1,&readfdsReal,NULL,NULL,timeoutPtr);
 		if(rtrn==-1) {
 			/* Forgotten why, but we do not do anything here. I once must have had a
 			 * very good reason, but I can't recall anymore. Let's just put in
@@ -461,100 +797,43 @@ enum jpnevulatorRtrn jpnevulatorRead(void) {
 			 * be considered cheating. Forgetting to reset this counter results in a slight different interpretation
 			 * of the --timing-delta option. Nice BUG, luckily found it myself. */
 			timeoutCount=0;
-			/* Walk through all our interfaces and see what needs to be done. */
-			if((interfaceReader=(struct interface *)listFirst(&_jpnevulatorOptions.interface))!=NULL) {
-				do {
-					if(FD_ISSET(interfaceReader->fd,&readfdsReal)) {
-						int size;
-						/* How many bytes should we read? */
-						if((_jpnevulatorOptions.count>0)&&(_jpnevulatorOptions.count<_jpnevulatorOptions.size)) {
-							/* We need less bytes than the input buffer can handle, so only take what needed. */
-							size=_jpnevulatorOptions.count;
-						} else {
-							/* Take as many as possible. No limit set or not yet within reach. */
-							size=_jpnevulatorOptions.size;
-						}
-						bytesRead=read(interfaceReader->fd,message,size);
-						if(bytesRead>0) {
-							/* Are we counting bytes and if so subtract the amount just read. */
-							if(_jpnevulatorOptions.count>0) {
-								_jpnevulatorOptions.count-=bytesRead;
-							}
-							headerWrite(output,ascii,asciiSize,&bytesWritten,interfaceReader,interfaceNameCopy,sizeof(interfaceNameCopy),&timeCurrent,&timeLast);
-							for(index=0;index<bytesRead;index++) {
-								if(bytesWritten>=_jpnevulatorOptions.width) {
-									asciiWrite(output,ascii,asciiSize,&bytesWritten,boolFalse);
-								} else if(bytesWritten!=0) {
-									fprintf(output," ");
-								}
-								if((bytesWritten==0)&&boolIsSet(_jpnevulatorOptions.byteCountDisplay)) {
-									fprintf(output,"%08lX\t",interfaceReader->byteCount);
-								}
-								bytePut(output,_jpnevulatorOptions.base,message[index]);
-								/* Increase the byte count for this interface. */
-								interfaceReader->byteCount++;
-								if(boolIsSet(_jpnevulatorOptions.ascii)) {
-									ascii[bytesWritten]=isprint(message[index])?message[index]:'.';
-								}
-								bytesWritten++;
-							}
-							/* Does the user want to pass the data between all the interfaces? */
-							if(boolIsSet(_jpnevulatorOptions.pass)) {
-								struct listElement *interfaceListPosition;
-								/* Save the current position in the interface list, since we are about to traverse
-								 * it again. */
-								interfaceListPosition=listCurrentPositionSave(&_jpnevulatorOptions.interface);
-								/* Traverse the interface list again in search for all the other (not this read) interface. For
-								 * every interface found write the read message to it. */
-								if((interfaceWriter=(struct interface *)listFirst(&_jpnevulatorOptions.interface))!=NULL) {
-									do {
-										if(interfaceWriter->fd!=interfaceReader->fd) {
-											ssize_t n;
-											n=write(interfaceWriter->fd,message,bytesRead);
-											if(n<0) {
-												fprintf(stderr,"%s: %s: write of %ld bytes failed(%ld).\n",PROGRAM_NAME,interfacePrint(interfaceWriter),bytesRead,n);
-											}
-										}
-									} while((interfaceWriter=(struct interface *)listNext(&_jpnevulatorOptions.interface))!=NULL);
-								}
-								/* Restore the current position for the interface list again. */
-								listCurrentPositionLoad(&_jpnevulatorOptions.interface,interfaceListPosition);
-							}
-							fflush(output);
-						}
-					}
-					/* See if we need to write some control data. */
-					if(boolIsSet(_jpnevulatorOptions.control)) {
-						controlHandle(output,ascii,asciiSize,&bytesWritten,interfaceReader,interfaceNameCopy,sizeof(interfaceNameCopy),&timeCurrent,&timeLast);
-					}
-				} while((_jpnevulatorOptions.count!=0)&&((interfaceReader=(struct interface *)listNext(&_jpnevulatorOptions.interface))!=NULL));
+			/* See if we need to write some control data. */
+			if(boolIsSet(_jpnevulatorOptions.control)) {
+				for(id=0;(_jpnevulatorOptions.count!=0)&&(id<interfaceCount());id++) {
+					controlHandle(_reader.output,interfaceGet(id),&_reader.interfaceLast,&_reader.timeCurrent,&_reader.timeLast);
+				}
 			}
 		} else {
 			/* Another timeout! Do we already need to write our ASCII data? */
 			if(timeoutCount>=timeoutDelta) {
-				asciiWrite(output,ascii,asciiSize,&bytesWritten,boolTrue);
+				formatLineEnd(boolTrue);
 				timeoutCount=0;
 			} else {
 				timeoutCount++;
 			}
 			/* See if we need to write some control data. */
 			if(boolIsSet(_jpnevulatorOptions.control)) {
-				if((interfaceReader=(struct interface *)listFirst(&_jpnevulatorOptions.interface))!=NULL) {
-					do {
-						controlHandle(output,ascii,asciiSize,&bytesWritten,interfaceReader,interfaceNameCopy,sizeof(interfaceNameCopy),&timeCurrent,&timeLast);
-					} while((interfaceReader=(struct interface *)listNext(&_jpnevulatorOptions.interface))!=NULL);
+				for(id=0;id<interfaceCount();id++) {
+					controlHandle(_reader.output,interfaceGet(id),&_reader.interfaceLast,&_reader.timeCurrent,&_reader.timeLast);
 				}
 			}
 		}
 	}
 
-	/* Might we possibly still need to write our ASCII data? */
-	asciiWrite(output,ascii,asciiSize,&bytesWritten,boolTrue);
-	
-	/* And if we didn't wrote our ASCII data we most probably need a newline. */
-	if(bytesWritten!=0) {
-		fprintf(output,"\n");	
+	/* Might we possibly still need to write our ASCII data or at least end the line? */
+	formatLineEnd(boolTrue);
+
+	/* Only wait for the bytes still queued if the user does not like to lose any. */
+	if(_jpnevulatorOptions.queuePolicy==queuePolicyBlock) {
+		queueDrain();
+	} else {
+		queueFlush();
 	}
+	queueReport(stderr);
+	if(boolIsSet(_jpnevulatorOptions.statistics)) {
+		statsReport(stderr);
+	}
+	statsExport();
 
 	/* Close files opened. */
 	jpnevulatorGarbageCollect();
@@ -562,3 +841,112 @@ enum jpnevulatorRtrn jpnevulatorRead(void) {
 	return(jpnevulatorRtrnOk);
 }
 #undef jpnevulatorGarbageCollect
+
+/* Nice way of leaving no traces...
+ * ...the more we know, the more we return. */
+#define jpnevulatorGarbageCollect() { \
+	interfaceDestroy(); \
+	if(input!=NULL) { \
+		ioClose(input); \
+	} \
+	formatDestroy(); \
+	captureDestroy(); \
+}
+enum jpnevulatorRtrn jpnevulatorRender(void) {
+	unsigned long *timeoutReference;
+	int timeoutDelta;
+	long long idle;
+	struct timestamp timeRecord,timePrevious;
+	bool_t first;
+	FILE *input;
+	enum jpnevulatorRtrn rtrnRender;
+
+	/* Open the capture to render. */
+	input=ioOpen("r");
+	if(input==NULL) {
+		perror(PROGRAM_NAME": Unable to open input");
+		jpnevulatorGarbageCollect();
+		return(jpnevulatorRtrnNoInput);
+	}
+	switch(captureOpen(input)) {
+		case captureRtrnOk: {
+			break;
+		}
+		case captureRtrnMemory: {
+			perror(PROGRAM_NAME": Unable to allocate memory for the capture");
+			jpnevulatorGarbageCollect();
+			return(jpnevulatorRtrnNoMessage);
+		}
+		default: {
+			fprintf(stderr,"%s: Input is not a binary capture of ours or it is damaged.\n",PROGRAM_NAME);
+			jpnevulatorGarbageCollect();
+			return(jpnevulatorRtrnNoInput);
+		}
+	}
+
+	/* We always render on standard output, using the very same formatter the
+	 * read mode uses. */
+	_reader.output=stdout;
+	if(formatInitialize(_reader.output)!=formatRtrnOk) {
+		perror(PROGRAM_NAME": Unable to allocate memory for the output lines");
+		jpnevulatorGarbageCollect();
+		return(jpnevulatorRtrnNoAscii);
+	}
+	_reader.interfaceLast=-1;
+
+	/* While reading, the ASCII data of a line is written once nothing came in for
+	 * a while. We can't wait for that to happen here, but the gaps between our
+	 * records tell us exactly when it did. */
+	if(boolIsSet(_jpnevulatorOptions.ascii)&&timeoutSelect(&timeoutReference,&timeoutDelta,boolFalse)) {
+		idle=(long long)*timeoutReference*(timeoutDelta+1)*1000LL;
+	} else {
+		idle=-1;
+	}
+
+	rtrnRender=jpnevulatorRtrnOk;
+	for(boolSet(first);;) {
+		struct interface *interface;
+		enum captureType type;
+		enum captureRtrn rtrn;
+		unsigned char *data;
+		ssize_t size;
+		rtrn=captureRead(&interface,&timeRecord,&type,&data,&size);
+		if(rtrn!=captureRtrnOk) {
+			if(rtrn!=captureRtrnEOF) {
+				fprintf(stderr,"%s: The capture is damaged, stopped rendering.\n",PROGRAM_NAME);
+				/* Whatever we rendered so far is fine, but the user should know
+				 * there was more. */
+				rtrnRender=jpnevulatorRtrnNoInput;
+			}
+			break;
+		}
+		if(boolIsSet(first)) {
+			/* The very same trick as in read mode, make sure our first data gets
+			 * its timing information. */
+			timestampInitialize(_jpnevulatorOptions.timingStyle,&timeRecord);
+			_reader.timeCurrent=timeRecord;
+			_reader.timeCurrent.monotonic.tv_sec-=(_jpnevulatorOptions.timingDelta/1000000L)+1;
+			boolReset(first);
+		} else if((idle>=0)&&(timestampDiff(&timeRecord,&timePrevious)>idle)) {
+			formatLineEnd(boolTrue);
+		}
+		timePrevious=timeRecord;
+		if(type==captureTypeControl) {
+			if(size>=sizeof(int32_t)) {
+				controlShow(_reader.output,interface,&_reader.interfaceLast,&_reader.timeCurrent,&_reader.timeLast,&timeRecord,*(int32_t *)data);
+			}
+		} else {
+			headerWrite(_reader.output,interface,&_reader.interfaceLast,&_reader.timeCurrent,&_reader.timeLast,&timeRecord);
+			formatBytes(interface,data,size);
+		}
+	}
+
+	/* Might we possibly still need to write our ASCII data or at least end the line? */
+	formatLineEnd(boolTrue);
+
+	/* Free allocated memory and close files opened. */
+	jpnevulatorGarbageCollect();
+
+	return(rtrnRender);
+}
+#undef jpnevulatorGarbageCollect
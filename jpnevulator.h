@@ -38,5 +38,6 @@ extern struct jpnevulatorOptions _jpnevulatorOptions;
 
 extern enum jpnevulatorRtrn jpnevulatorWrite(void);
 extern enum jpnevulatorRtrn jpnevulatorRead(void);
+extern enum jpnevulatorRtrn jpnevulatorRender(void);
 
 #endif
@@ -36,6 +36,10 @@ int main(int argc,char **argv) {
 				returnValue=jpnevulatorWrite();
 				break;
 			}
+			case actionTypeRender: {
+				returnValue=jpnevulatorRender();
+				break;
+			}
 			case actionTypeNone:
 			default: {
 				/* Should be impossible. :-) */
@@ -0,0 +1,218 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+
+#include "jpnevulator.h"
+#include "interface.h"
+#include "reactor.h"
+#include "ring.h"
+#include "timestamp.h"
+#include "stats.h"
+#include "monitor.h"
+
+/* The amount of control changes a monitor can have waiting for the main loop. */
+#define MONITOR_RING_SLOTS 64
+/* The amount of microseconds a monitor waits for the main loop to make some room
+ * in its ring. */
+#define MONITOR_RING_FULL_WAIT 1000
+/* The signal that wakes a monitor thread to tell it to stop. */
+#define MONITOR_SIGNAL SIGUSR2
+
+struct monitorEvent {
+	struct timestamp time;
+	int control;
+};
+
+struct monitor {
+	struct interface *interface;
+	struct ring ring;
+	pthread_t thread;
+	bool_t running;
+	/* Set by us to tell the thread to stop, set by the thread once it did. */
+	atomic_int stop;
+	atomic_int stopped;
+};
+
+static struct monitor *_monitors=NULL;
+static int _monitorsCount=0;
+static int _eventFd=-1;
+static void (*_handler)(struct interface *,struct timestamp *,int);
+
+/* Nothing to do, the signal is only there to break off the wait. */
+static void monitorSignal(int signal) {
+}
+
+static void monitorEventPush(struct monitor *monitor,struct timestamp *time,int control) {
+	struct monitorEvent *event;
+	while((event=(struct monitorEvent *)ringProduceGet(&monitor->ring))==NULL) {
+		if(atomic_load(&monitor->stop)) {
+			return;
+		}
+		usleep(MONITOR_RING_FULL_WAIT);
+	}
+	event->time=*time;
+	event->control=control;
+	ringProduce(&monitor->ring);
+	eventfd_write(_eventFd,1);
+}
+
+/* This is where every monitor thread spends its life. It waits for the modem control
+ * bits of its interface to change and tells the main loop when they did, together
+ * with the time they did. A change that is gone again before we could have a look
+ * is reported too, as two changes at the same time. If the interface suddenly
+ * refuses to wait, we fall back to good old polling. To stop a monitor we raise
+ * its stop flag and send it MONITOR_SIGNAL, which breaks off the wait. */
+static void *monitorThread(void *data) {
+	struct interfaceControlCount count;
+	struct monitor *monitor;
+	int control;
+	monitor=(struct monitor *)data;
+	statsSignalsBlock();
+	boolReset(count.valid);
+	control=monitor->interface->control;
+	while(!atomic_load(&monitor->stop)) {
+		struct timestamp time;
+		int pulsed,now;
+		pulsed=monitor->interface->controlWait(monitor->interface->fd,&count);
+		if(pulsed<0) {
+			if(errno==EINTR) {
+				continue;
+			}
+			usleep(_jpnevulatorOptions.controlPoll);
+			pulsed=0;
+		}
+		timestampGet(&time);
+		now=interfaceControlGet(monitor->interface);
+		if(pulsed!=0) {
+			monitorEventPush(monitor,&time,now^pulsed);
+			control=now^pulsed;
+		}
+		if(now!=control) {
+			monitorEventPush(monitor,&time,now);
+			control=now;
+		}
+	}
+	atomic_store(&monitor->stopped,1);
+	return(NULL);
+}
+
+/* Hand out all the changes waiting to our handler. */
+static void monitorNotified(void *data) {
+	eventfd_t value;
+	int index;
+	eventfd_read(_eventFd,&value);
+	for(index=0;index<_monitorsCount;index++) {
+		struct monitorEvent *event;
+		while((event=(struct monitorEvent *)ringConsumeGet(&_monitors[index].ring))!=NULL) {
+			_handler(_monitors[index].interface,&event->time,event->control);
+			ringConsume(&_monitors[index].ring);
+		}
+	}
+}
+
+/* Start a monitor thread for every interface able to wait for changes of its modem
+ * control bits. The changes will be handed to the given handler from within the
+ * reactor. All the other interfaces still need to be polled. */
+enum monitorRtrn monitorStart(void (*handler)(struct interface *,struct timestamp *,int)) {
+	struct interface *interface;
+	int id;
+	int index;
+	struct sigaction action;
+	_handler=handler;
+	_monitorsCount=0;
+	_monitors=(struct monitor *)calloc(max(1,interfaceCount()),sizeof(struct monitor));
+	if(_monitors==NULL) {
+		return(monitorRtrnMemory);
+	}
+	for(id=0;id<interfaceCount();id++) {
+		interface=interfaceGet(id);
+		if(interface->controlWait==NULL) {
+			continue;
+		}
+		_monitors[_monitorsCount].interface=interface;
+		if(ringInitialize(&_monitors[_monitorsCount].ring,MONITOR_RING_SLOTS,sizeof(struct monitorEvent))!=ringRtrnOk) {
+			return(monitorRtrnMemory);
+		}
+		_monitorsCount++;
+	}
+	if(_monitorsCount==0) {
+		return(monitorRtrnOk);
+	}
+	_eventFd=eventfd(0,EFD_CLOEXEC|EFD_NONBLOCK);
+	if(_eventFd==-1) {
+		return(monitorRtrnNotify);
+	}
+	if(reactorAdd(_eventFd,monitorNotified,NULL,NULL)!=reactorRtrnOk) {
+		return(monitorRtrnNotify);
+	}
+	/* Without SA_RESTART, so the wait of a monitor returns once signalled. */
+	memset(&action,0,sizeof(action));
+	action.sa_handler=monitorSignal;
+	sigemptyset(&action.sa_mask);
+	if(sigaction(MONITOR_SIGNAL,&action,NULL)!=0) {
+		return(monitorRtrnThread);
+	}
+	for(index=0;index<_monitorsCount;index++) {
+		atomic_init(&_monitors[index].stop,0);
+		atomic_init(&_monitors[index].stopped,0);
+		if(pthread_create(&_monitors[index].thread,NULL,monitorThread,(void *)&_monitors[index])!=0) {
+			return(monitorRtrnThread);
+		}
+		boolSet(_monitors[index].running);
+	}
+	return(monitorRtrnOk);
+}
+
+void monitorStop(void) {
+	int index;
+	if(_monitors==NULL) {
+		return;
+	}
+	for(index=0;index<_monitorsCount;index++) {
+		if(boolIsSet(_monitors[index].running)) {
+			/* The signal might come in right before the thread starts to wait,
+			 * so keep on sending it until the thread tells us it stopped. */
+			atomic_store(&_monitors[index].stop,1);
+			while(!atomic_load(&_monitors[index].stopped)) {
+				pthread_kill(_monitors[index].thread,MONITOR_SIGNAL);
+				usleep(MONITOR_RING_FULL_WAIT);
+			}
+			pthread_join(_monitors[index].thread,NULL);
+		}
+		ringDestroy(&_monitors[index].ring);
+	}
+	if(_monitorsCount>0) {
+		signal(MONITOR_SIGNAL,SIG_DFL);
+	}
+	free(_monitors);
+	_monitors=NULL;
+	_monitorsCount=0;
+	if(_eventFd!=-1) {
+		close(_eventFd);
+		_eventFd=-1;
+	}
+}
@@ -26,7 +26,7 @@
 #include "io.h"
 #include "crc16.h"
 #include "crc8.h"
-#include "list.h"
+#include "crc.h"
 #include "interface.h"
 #include "tty.h"
 #include "pty.h"
@@ -35,17 +35,41 @@
 static void usage(void) {
 	printf(
 		"Usage: %s [--version] [--help] [--checksum] [--crc16=poly]\n"
-		"         [--crc8=poly] [--fuck-up] [--file=file] [--no-send]\n"
-		"         [--delay-line=microseconds] [--delay-byte=microseconds]\n"
-		"         [--print] [--size=size] [--tty=tty] [--pty [=alias]] [--width] [--pass]\n"
+		"         [--crc8=poly] [--crc=name|spec|list] [--fuck-up] [--file=file]\n"
+		"         [--no-send] [--delay-line=microseconds] [--delay-byte=microseconds]\n"
+		"         [--delay-spin=microseconds] [--wire [=percent]]\n"
+		"         [--replay [=speed]] [--compile=file] [--batch [=bytes]]\n"
+		"         [--batch-lines=lines]\n"
+		"         [--print] [--size=size] [--serial=settings] [--tty=tty]\n"
+		"         [--pty [=alias]] [--width] [--pass]\n"
 		"         [--read] [--write] [--timing-print] [--timing-delta=microseconds]\n"
+		"         [--timing-style=micro|nano|delta]\n"
 		"         [--ascii] [--alias-separator=separator] [--byte-count]\n"
 		"         [--append] [--append-separator=separator] [--control]\n"
-		"         [--control-poll=microseconds] [--count=bytes] [--base] <file>\n",
+		"         [--control-poll=microseconds] [--count=bytes] [--base]\n"
+		"         [--thread] [--buffer-size=bytes] [--capture-format=text|binary]\n"
+		"         [--render] [--queue-size=bytes]\n"
+		"         [--queue-policy=block|drop-oldest|drop-newest]\n"
+		"         [--statistics [=seconds]] [--histogram=file] <file>\n",
 		PROGRAM_NAME
 	);
 }
 
+/* The amount of bytes the checksum takes at the end of a message. */
+int optionsChecksumSize(void) {
+	switch(_jpnevulatorOptions.checksum) {
+		case checksumTypeNone: {
+			return(0);
+		}
+		case checksumTypeCrc: {
+			return(crcSize(&_jpnevulatorOptions.crc));
+		}
+		default: {
+			return(2);
+		}
+	}
+}
+
 static void optionsDefault(void) {
 	/* Don't add a checksum by default. */
 	_jpnevulatorOptions.checksum=checksumTypeNone;
@@ -65,6 +89,9 @@ static void optionsDefault(void) {
 	 * multiple I/O sources. Which we of course neglect anyway. */
 	sprintf(_jpnevulatorOptions.io,"%.*s",(int)sizeof(_jpnevulatorOptions.io)-1,ioMAGIC);
 
+	/* Leave the settings of our ttys alone by default. */
+	boolReset(_jpnevulatorOptions.serial.given);
+
 	/* Initialize the list where we store our interfaces. We do not yet add
 	 * the default interface. We postpone that up untill we know for sure the user
 	 * did not gave us any interface. */
@@ -73,6 +100,11 @@ static void optionsDefault(void) {
 	/* By default we expect to send/receive Cham2 messages. */
 	_jpnevulatorOptions.size=22;
 
+	/* By default we read up to 64KiB at once. This has nothing to do with
+	 * the size of the messages, it just saves us a lot of system calls
+	 * when the line is busy. */
+	_jpnevulatorOptions.bufferSize=65536;
+
 	/* By default we send our messages on the serial port... */
 	boolSet(_jpnevulatorOptions.send);
 
@@ -85,6 +117,26 @@ static void optionsDefault(void) {
 	/* Do not delay between bytes by default. */
 	_jpnevulatorOptions.delayByte=0L;
 
+	/* Sleep all the way if we delay, don't spin. */
+	_jpnevulatorOptions.delaySpin=0L;
+
+	/* Send every message on its own by default. Once batched, gather up to
+	 * 4KiB at once, no matter how many messages that are. */
+	_jpnevulatorOptions.batchSize=0;
+	_jpnevulatorOptions.batchLines=0;
+
+	/* Send our messages, don't compile them by default. */
+	_jpnevulatorOptions.compile=NULL;
+
+	/* By default our input is no capture to replay. If it is, replay it at the
+	 * speed it was captured. */
+	boolReset(_jpnevulatorOptions.replay);
+	_jpnevulatorOptions.replaySpeed=1.0;
+
+	/* Write as fast as the kernel takes our bytes, no matter how long they take
+	 * on the wire. */
+	_jpnevulatorOptions.wireRate=0;
+
 	/* Action type is mandatory (not by getopts, but by our own mechanism). */
 	_jpnevulatorOptions.action=actionTypeNone;
 
@@ -97,6 +149,12 @@ static void optionsDefault(void) {
 	/* By default we couple bytes that arrive within 100 miliseconds. */
 	_jpnevulatorOptions.timingDelta=100000UL;
 
+	/* By default we display the date and time, up to the microsecond. */
+	_jpnevulatorOptions.timingStyle=timestampStyleMicro;
+
+	/* By default we capture in good old readable text. */
+	_jpnevulatorOptions.captureFormat=captureFormatText;
+
 	/* By default we do not display ascii data in read mode. */
 	boolReset(_jpnevulatorOptions.ascii);
 
@@ -109,12 +167,28 @@ static void optionsDefault(void) {
 	/* Do not pass bytes between interfaces by default. */
 	boolReset(_jpnevulatorOptions.pass);
 
+	/* Read all interfaces from within a single thread by default. */
+	boolReset(_jpnevulatorOptions.thread);
+
 	/* Do not poll modem control bits by default. */
 	boolReset(_jpnevulatorOptions.control);
 
 	/* Poll every milisecond by default (should suffice for 9600bps). */
 	_jpnevulatorOptions.controlPoll=1000UL;
 
+	/* By default every interface can have up to 64KiB waiting to be written... */
+	_jpnevulatorOptions.queueSize=65536;
+
+	/* ...and once that's full we wait for it, so not a single byte gets lost. */
+	_jpnevulatorOptions.queuePolicy=queuePolicyBlock;
+
+	/* Only show our statistics when asked for by a signal. Never on our own. */
+	boolReset(_jpnevulatorOptions.statistics);
+	_jpnevulatorOptions.statisticsInterval=0UL;
+
+	/* Keep our histograms to ourselves by default. */
+	_jpnevulatorOptions.histogram=NULL;
+
 	/* By default we read/write endlessly up untill the end of time. */
 	_jpnevulatorOptions.count=-1;
 
@@ -124,8 +198,10 @@ static void optionsDefault(void) {
 	/* By default the append separator is a simple newline. */
 	_jpnevulatorOptions.appendSeparator="\n";
 
-	/* By default, read/write hex byte values. */
+	/* By default, read/write hex byte values. Whatever the base, create the
+	 * tables we print the bytes with. */
 	_jpnevulatorOptions.base=byteBaseHexadecimal;
+	byteTableCreate();
 }
 
 static void optionsIOWrite(char *file) {
@@ -160,36 +236,53 @@ enum optionsRtrn optionsParse(int argc,char **argv) {
 		static struct option long_options[]={
 			{"append",no_argument,NULL,'A'},
 			{"ascii",no_argument,NULL,'a'},
+			{"batch",optional_argument,NULL,'H'},
+			{"batch-lines",required_argument,NULL,'L'},
 			{"byte-count",no_argument,NULL,'b'},
 			{"base",required_argument,NULL,'B'},
+			{"buffer-size",required_argument,NULL,'u'},
 			{"checksum",no_argument,NULL,'c'},
 			{"control",no_argument,NULL,'C'},
 			{"control-poll",required_argument,NULL,'D'},
+			{"capture-format",required_argument,NULL,'F'},
 			{"delay-line",required_argument,NULL,'d'},
 			{"timing-delta",required_argument,NULL,'e'},
 			{"file",required_argument,NULL,'f'},
 			{"timing-print",no_argument,NULL,'g'},
+			{"timing-style",required_argument,NULL,'G'},
 			{"help",no_argument,NULL,'h'},
+			{"histogram",required_argument,NULL,'x'},
 			{"width",required_argument,NULL,'i'},
 			{"fuck-up",no_argument,NULL,'j'},
 			{"delay-byte",required_argument,NULL,'k'},
+			{"delay-spin",required_argument,NULL,'K'},
 			{"alias-separator",required_argument,NULL,'l'},
 			{"no-send",no_argument,NULL,'n'},
 			{"count",required_argument,NULL,'o'},
 			{"pass",no_argument,NULL,'P'},
 			{"print",no_argument,NULL,'p'},
 			{"pty",optional_argument,NULL,'q'},
+			{"queue-policy",required_argument,NULL,'O'},
+			{"queue-size",required_argument,NULL,'Q'},
 			{"read",no_argument,NULL,'r'},
+			{"render",no_argument,NULL,'R'},
+			{"replay",optional_argument,NULL,'Z'},
+			{"serial",required_argument,NULL,'X'},
 			{"size",required_argument,NULL,'s'},
 			{"append-separator",required_argument,NULL,'S'},
+			{"statistics",optional_argument,NULL,'U'},
+			{"thread",no_argument,NULL,'T'},
 			{"tty",required_argument,NULL,'t'},
 			{"version",no_argument,NULL,'v'},
+			{"wire",optional_argument,NULL,'W'},
 			{"write",no_argument,NULL,'w'},
 			{"crc16",optional_argument,NULL,'y'},
 			{"crc8",optional_argument,NULL,'z'},
+			{"crc",required_argument,NULL,'Y'},
+			{"compile",required_argument,NULL,'M'},
 			{NULL,no_argument,NULL,0}
 		};
-		option=getopt_long(argc,argv,"aAbB:cCd:D:e:f:ghi:jk:l:no:pPq:rs:S:t:vwy:z:",long_options,&option_index);
+		option=getopt_long(argc,argv,"aAbB:cCd:D:e:f:F:gG:hH::i:jk:K:l:L:M:no:O:pPq:Q:rRs:S:t:Tu:U::vwW::x:X:y:Y:z:Z::",long_options,&option_index);
 		switch(option) {
 			case -1: {
 				finished=!finished;
@@ -247,14 +340,48 @@ enum optionsRtrn optionsParse(int argc,char **argv) {
 				optionsIOWrite(optarg);
 				break;
 			}
+			case 'F': {
+				if(strcmp(optarg,"text")==0) {
+					_jpnevulatorOptions.captureFormat=captureFormatText;
+				} else if(strcmp(optarg,"binary")==0) {
+					_jpnevulatorOptions.captureFormat=captureFormatBinary;
+				} else {
+					fprintf(stderr,"%s: Unsupported capture format selected, cowardly using the default text format.\n",PROGRAM_NAME);
+					_jpnevulatorOptions.captureFormat=captureFormatText;
+				}
+				break;
+			}
 			case 'g': {
 				boolSet(_jpnevulatorOptions.timingPrint);
 				break;
 			}
+			case 'G': {
+				if(strcmp(optarg,"micro")==0) {
+					_jpnevulatorOptions.timingStyle=timestampStyleMicro;
+				} else if(strcmp(optarg,"nano")==0) {
+					_jpnevulatorOptions.timingStyle=timestampStyleNano;
+				} else if(strcmp(optarg,"delta")==0) {
+					_jpnevulatorOptions.timingStyle=timestampStyleDelta;
+				} else {
+					fprintf(stderr,"%s: Unsupported timing style selected, cowardly using the default micro style.\n",PROGRAM_NAME);
+					_jpnevulatorOptions.timingStyle=timestampStyleMicro;
+				}
+				break;
+			}
 			case 'h': {
 				usage();
 				return(optionsRtrnUsage);
 			}
+			case 'H': {
+				int size;
+				size=optarg!=NULL?atoi(optarg):4096;
+				if(size>0) {
+					_jpnevulatorOptions.batchSize=size;
+				} else {
+					fprintf(stderr,"%s: Discarding batch size. It should be bigger than zero.\n",PROGRAM_NAME);
+				}
+				break;
+			}
 			case 'i': {
 				int width;
 				width=atoi(optarg);
@@ -279,10 +406,38 @@ enum optionsRtrn optionsParse(int argc,char **argv) {
 				}
 				break;
 			}
+			case 'K': {
+				unsigned long spin;
+				spin=atol(optarg);
+				if(spin>0) {
+					_jpnevulatorOptions.delaySpin=spin;
+				} else {
+					fprintf(stderr,"%s: Discarding delay spin. It should be bigger than zero.\n",PROGRAM_NAME);
+				}
+				break;
+			}
 			case 'l': {
 				_jpnevulatorOptions.aliasSeparator=optarg;
 				break;
 			}
+			case 'L': {
+				int lines;
+				lines=atoi(optarg);
+				if(lines>0) {
+					_jpnevulatorOptions.batchLines=lines;
+				} else {
+					fprintf(stderr,"%s: Discarding batch lines. It should be bigger than zero.\n",PROGRAM_NAME);
+				}
+				break;
+			}
+			case 'x': {
+				_jpnevulatorOptions.histogram=optarg;
+				break;
+			}
+			case 'M': {
+				_jpnevulatorOptions.compile=optarg;
+				break;
+			}
 			case 'n': {
 				boolReset(_jpnevulatorOptions.send);
 				break;
@@ -297,6 +452,19 @@ enum optionsRtrn optionsParse(int argc,char **argv) {
 				}
 				break;
 			}
+			case 'O': {
+				if(strcmp(optarg,"block")==0) {
+					_jpnevulatorOptions.queuePolicy=queuePolicyBlock;
+				} else if(strcmp(optarg,"drop-oldest")==0) {
+					_jpnevulatorOptions.queuePolicy=queuePolicyDropOldest;
+				} else if(strcmp(optarg,"drop-newest")==0) {
+					_jpnevulatorOptions.queuePolicy=queuePolicyDropNewest;
+				} else {
+					fprintf(stderr,"%s: Unsupported queue policy selected, cowardly using the default block policy.\n",PROGRAM_NAME);
+					_jpnevulatorOptions.queuePolicy=queuePolicyBlock;
+				}
+				break;
+			}
 			case 'p': {
 				boolSet(_jpnevulatorOptions.print);
 				break;
@@ -309,6 +477,16 @@ enum optionsRtrn optionsParse(int argc,char **argv) {
 				ptyAdd(optarg);
 				break;
 			}
+			case 'Q': {
+				int size;
+				size=atoi(optarg);
+				if(size>0) {
+					_jpnevulatorOptions.queueSize=size;
+				} else {
+					fprintf(stderr,"%s: Discarding queue size. It should be bigger than zero.\n",PROGRAM_NAME);
+				}
+				break;
+			}
 			case 'r': {
 				if(_jpnevulatorOptions.action!=actionTypeNone) {
 					fprintf(stderr,"%s: Use --read or --write, but not both. Performing a read this time.\n",PROGRAM_NAME);
@@ -316,6 +494,13 @@ enum optionsRtrn optionsParse(int argc,char **argv) {
 				_jpnevulatorOptions.action=actionTypeRead;
 				break;
 			}
+			case 'R': {
+				if(_jpnevulatorOptions.action!=actionTypeNone) {
+					fprintf(stderr,"%s: Use --read, --write or --render, but only one of them. Performing a render this time.\n",PROGRAM_NAME);
+				}
+				_jpnevulatorOptions.action=actionTypeRender;
+				break;
+			}
 			case 's': {
 				int size;
 				size=atoi(optarg);
@@ -334,6 +519,33 @@ enum optionsRtrn optionsParse(int argc,char **argv) {
 				ttyAdd(optarg);
 				break;
 			}
+			case 'T': {
+				boolSet(_jpnevulatorOptions.thread);
+				break;
+			}
+			case 'u': {
+				int size;
+				size=atoi(optarg);
+				if(size>0) {
+					_jpnevulatorOptions.bufferSize=size;
+				} else {
+					fprintf(stderr,"%s: Discarding buffer size. It should be bigger than zero.\n",PROGRAM_NAME);
+				}
+				break;
+			}
+			case 'U': {
+				boolSet(_jpnevulatorOptions.statistics);
+				if(optarg!=NULL) {
+					long interval;
+					interval=atol(optarg);
+					if(interval>0) {
+						_jpnevulatorOptions.statisticsInterval=interval;
+					} else {
+						fprintf(stderr,"%s: Discarding statistics interval. It should be bigger than zero.\n",PROGRAM_NAME);
+					}
+				}
+				break;
+			}
 			case 'v': {
 				printf(
 					"%s version %s\n"
@@ -352,6 +564,24 @@ enum optionsRtrn optionsParse(int argc,char **argv) {
 				_jpnevulatorOptions.action=actionTypeWrite;
 				break;
 			}
+			case 'W': {
+				int rate;
+				rate=optarg!=NULL?atoi(optarg):100;
+				if((rate>0)&&(rate<=100)) {
+					_jpnevulatorOptions.wireRate=rate;
+				} else {
+					fprintf(stderr,"%s: Discarding wire rate. It should be a percentage bigger than zero.\n",PROGRAM_NAME);
+				}
+				break;
+			}
+			case 'X': {
+				/* Applies to all ttys given from now on. */
+				if(serialParse(&_jpnevulatorOptions.serial,optarg)!=serialRtrnOk) {
+					fprintf(stderr,"%s: Invalid serial settings \"%s\".\n",PROGRAM_NAME,optarg);
+					return(optionsRtrnUsage);
+				}
+				break;
+			}
 			case 'y': {
 				_jpnevulatorOptions.checksum=checksumTypeCrc16;
 				if(optarg) {
@@ -361,6 +591,47 @@ enum optionsRtrn optionsParse(int argc,char **argv) {
 				}
 				break;
 			}
+			case 'Y': {
+				if(strcmp(optarg,"list")==0) {
+					crcList(stdout);
+					return(optionsRtrnList);
+				}
+				switch(crcParse(&_jpnevulatorOptions.crc,optarg)) {
+					case crcRtrnOk: {
+						_jpnevulatorOptions.checksum=checksumTypeCrc;
+						break;
+					}
+					case crcRtrnUnknown: {
+						fprintf(stderr,"%s: Unknown crc in \"%s\", see --crc=list for the ones we know.\n",PROGRAM_NAME,optarg);
+						return(optionsRtrnUsage);
+					}
+					case crcRtrnInvalid:
+					default: {
+						fprintf(stderr,"%s: Invalid crc specification \"%s\".\n",PROGRAM_NAME,optarg);
+						return(optionsRtrnUsage);
+					}
+				}
+				break;
+			}
+			case 'Z': {
+				double speed;
+				char *end;
+				boolSet(_jpnevulatorOptions.replay);
+				if(optarg==NULL) {
+					break;
+				}
+				if(strcasecmp(optarg,"max")==0) {
+					_jpnevulatorOptions.replaySpeed=0.0;
+					break;
+				}
+				speed=strtod(optarg,&end);
+				if((end!=optarg)&&(speed>=0.0)&&((*end=='\0')||(strcasecmp(end,"x")==0))) {
+					_jpnevulatorOptions.replaySpeed=speed;
+				} else {
+					fprintf(stderr,"%s: Discarding replay speed. It should be a factor like 2 or 0.5, or max.\n",PROGRAM_NAME);
+				}
+				break;
+			}
 			case 'z': {
 				_jpnevulatorOptions.checksum=checksumTypeCrc8;
 				if(optarg) {
@@ -390,9 +661,32 @@ enum optionsRtrn optionsParse(int argc,char **argv) {
 		_jpnevulatorOptions.action=actionTypeWrite;
 	}
 
+	/* The checksum is added to the message, which is never bigger than --size. So
+	 * there should be room for at least a byte of message next to it. */
+	if((_jpnevulatorOptions.action==actionTypeWrite)&&(_jpnevulatorOptions.size<=optionsChecksumSize())) {
+		fprintf(stderr,"%s: A size of %d leaves no room for a message next to its %d byte checksum.\n",PROGRAM_NAME,_jpnevulatorOptions.size,optionsChecksumSize());
+		return(optionsRtrnUsage);
+	}
+
+	/* A render only knows about the interfaces in the capture. */
+	if(_jpnevulatorOptions.action==actionTypeRender) {
+		if(interfaceCount()>0) {
+			fprintf(stderr,"%s: Ignoring the interfaces given, a render uses the ones of the capture.\n",PROGRAM_NAME);
+			interfaceDestroy();
+			interfaceInitialize();
+		}
+		return(optionsRtrnOk);
+	}
+
+	/* Appending to a binary capture would put a second header in the middle of it. */
+	if((_jpnevulatorOptions.captureFormat==captureFormatBinary)&&boolIsSet(_jpnevulatorOptions.append)) {
+		fprintf(stderr,"%s: Can't append to a binary capture, overwriting it instead.\n",PROGRAM_NAME);
+		boolReset(_jpnevulatorOptions.append);
+	}
+
 	/* If the user did not mentioned any interface we will by default
-	 * open the /dev/ttyS0 device. */
-	if(listElements(&_jpnevulatorOptions.interface)==0) {
+	 * open the /dev/ttyS0 device. Unless all we do is compile messages. */
+	if((interfaceCount()==0)&&(_jpnevulatorOptions.compile==NULL)) {
 		ttyAdd("/dev/ttyS0");
 	}
 
@@ -19,58 +19,87 @@
 #ifndef __OPTIONS_H
 #define __OPTIONS_H
 
-#include "list.h"
 #include "misc.h"
 #include "byte.h"
+#include "crc.h"
+#include "timestamp.h"
+#include "queue.h"
+#include "serial.h"
 
 enum checksumType {
 	checksumTypeNone=0,
 	checksumTypeChecksum,
 	checksumTypeCrc16,
-	checksumTypeCrc8
+	checksumTypeCrc8,
+	checksumTypeCrc
 };
 
 enum actionType {
 	actionTypeNone=0,
 	actionTypeRead,
-	actionTypeWrite
+	actionTypeWrite,
+	actionTypeRender
+};
+
+enum captureFormat {
+	captureFormatText=0,
+	captureFormatBinary
 };
 
 struct jpnevulatorOptions {
 	enum checksumType checksum;
 	unsigned int crc16Poly;
 	unsigned char crc8Poly;
+	struct crc crc;
 	bool_t checksumFuckup;
 	char io[256];
-	list_t interface;
 	int size;
+	int bufferSize;
 	bool_t send;
 	bool_t print;
 	unsigned long delayLine;
 	unsigned long delayByte;
+	unsigned long delaySpin;
+	int wireRate;
+	struct serialSettings serial;
+	int batchSize;
+	int batchLines;
+	char *compile;
+	bool_t replay;
+	double replaySpeed;
 	enum actionType action;
 	int width;
 	bool_t timingPrint;
 	unsigned long timingDelta;
+	enum timestampStyle timingStyle;
+	enum captureFormat captureFormat;
 	bool_t ascii;
 	char *aliasSeparator;
 	bool_t byteCountDisplay;
 	bool_t pass;
+	bool_t thread;
 	bool_t control;
 	unsigned long controlPoll;
 	int count;
 	bool_t append;
 	char *appendSeparator;
 	enum byteBase base;
+	int queueSize;
+	enum queuePolicy queuePolicy;
+	bool_t statistics;
+	unsigned long statisticsInterval;
+	char *histogram;
 };
 
 enum optionsRtrn {
 	optionsRtrnOk=0,
 	optionsRtrnUsage,
 	optionsRtrnVersion,
+	optionsRtrnList,
 	optionsRtrnImpossible
 };
 
 extern enum optionsRtrn optionsParse(int,char **);
+extern int optionsChecksumSize(void);
 
 #endif
@@ -0,0 +1,150 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+
+#include "jpnevulator.h"
+#include "pace.h"
+
+/* Our delays are not counted from the moment we are done writing, but from
+ * the moment the previous delay should have ended. That's the deadline. This
+ * way the time spend writing, the time the kernel lets us wait before we get
+ * our turn again and the time we oversleep don't add up over a long run. If we
+ * are late, the next delay is simply shorter. Only if we are very late, like
+ * when an interface held us up, we give up on catching up and start counting
+ * from now, otherwise a burst of bytes would go out without any delay at all.
+ * Something that came in late, like a message after a pause in our input, is
+ * anchored with paceAnchor(), so its delay is never shorter. Only a replay
+ * keeps on counting from its previous deadline, it follows a timeline of its
+ * own. A deadline only counts as missed if we overslept it, not when we were
+ * asked to wait for it once it was gone already. */
+static struct {
+	struct timespec start;
+	struct timespec deadline;
+	unsigned long waits;
+	unsigned long missed;
+	long long lateTotal;
+	long long lateMax;
+} _pace;
+
+#define PACE_NSEC_PER_SEC 1000000000L
+/* The amount of nanoseconds we may be late before we give up on catching up,
+ * in case that is more than the delay itself. Short delays are often missed
+ * by a little, there is no need to give up on those. */
+#define PACE_RESYNC 10000000LL
+
+static void paceAdd(struct timespec *time,long long nanoseconds) {
+	time->tv_sec+=nanoseconds/PACE_NSEC_PER_SEC;
+	time->tv_nsec+=nanoseconds%PACE_NSEC_PER_SEC;
+	if(time->tv_nsec>=PACE_NSEC_PER_SEC) {
+		time->tv_sec++;
+		time->tv_nsec-=PACE_NSEC_PER_SEC;
+	} else if(time->tv_nsec<0) {
+		time->tv_sec--;
+		time->tv_nsec+=PACE_NSEC_PER_SEC;
+	}
+}
+
+static long long paceDiff(struct timespec *later,struct timespec *earlier) {
+	return(((long long)(later->tv_sec-earlier->tv_sec)*PACE_NSEC_PER_SEC)+later->tv_nsec-earlier->tv_nsec);
+}
+
+void paceInitialize(void) {
+	clock_gettime(CLOCK_MONOTONIC,&_pace.start);
+	_pace.deadline=_pace.start;
+	_pace.waits=0;
+	_pace.missed=0;
+	_pace.lateTotal=0;
+	_pace.lateMax=0;
+}
+
+/* Count the next delay from now if the previous deadline is gone already. */
+void paceAnchor(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	if(paceDiff(&now,&_pace.deadline)>0) {
+		_pace.deadline=now;
+	}
+}
+
+/* Wait until the given amount of nanoseconds after the previous deadline. */
+void paceWaitNanoseconds(long long nanoseconds) {
+	struct timespec now,asked;
+	long long late;
+	paceAdd(&_pace.deadline,nanoseconds);
+	/* The earliest we could have woken up. */
+	clock_gettime(CLOCK_MONOTONIC,&asked);
+	if(paceDiff(&asked,&_pace.deadline)<0) {
+		asked=_pace.deadline;
+	}
+	/* Sleep until a little before the deadline if the user likes us to spin
+	 * the rest of the way. Waking up takes its time, spinning doesn't. */
+	if(_jpnevulatorOptions.delaySpin>0) {
+		struct timespec wakeup;
+		wakeup=_pace.deadline;
+		paceAdd(&wakeup,-(long long)_jpnevulatorOptions.delaySpin*1000LL);
+		while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&wakeup,NULL)==EINTR);
+		do {
+			clock_gettime(CLOCK_MONOTONIC,&now);
+		} while(paceDiff(&now,&_pace.deadline)<0);
+	} else {
+		while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&_pace.deadline,NULL)==EINTR);
+		clock_gettime(CLOCK_MONOTONIC,&now);
+	}
+	/* How much did we oversleep? */
+	late=max(0LL,paceDiff(&now,&asked));
+	_pace.waits++;
+	_pace.lateTotal+=late;
+	_pace.lateMax=max(_pace.lateMax,late);
+	if(late>max(PACE_RESYNC,nanoseconds)) {
+		_pace.missed++;
+	}
+	if(paceDiff(&now,&_pace.deadline)>max(PACE_RESYNC,nanoseconds)) {
+		_pace.deadline=now;
+	}
+}
+
+/* Wait until the given amount of microseconds after the previous deadline. */
+void paceWait(unsigned long microseconds) {
+	paceWaitNanoseconds((long long)microseconds*1000LL);
+}
+
+/* Tell the user how fast we went and how well we kept up with our deadlines.
+ * Nothing to tell if we never waited. */
+void paceReport(FILE *output,unsigned long bytes) {
+	struct timespec now;
+	long long elapsed;
+	if(_pace.waits==0) {
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	elapsed=max(1LL,paceDiff(&now,&_pace.start));
+	fprintf(
+		output,
+		"%s: %lu bytes in %lld.%06llds, %lld bytes/s, deadlines met within %lldus on average and %lldus at most",
+		PROGRAM_NAME,bytes,elapsed/PACE_NSEC_PER_SEC,(elapsed%PACE_NSEC_PER_SEC)/1000LL,
+		(long long)((bytes*(double)PACE_NSEC_PER_SEC)/elapsed),
+		(_pace.lateTotal/(long long)_pace.waits)/1000LL,_pace.lateMax/1000LL
+	);
+	if(_pace.missed>0) {
+		fprintf(output,", %lu of %lu missed",_pace.missed,_pace.waits);
+	}
+	fprintf(output,".\n");
+}
@@ -0,0 +1,305 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include "jpnevulator.h"
+#include "ring.h"
+#include "stats.h"
+#include "pipeline.h"
+
+/* In write mode with --thread the work is split over three stages. The parser
+ * thread decodes and checksums the messages, we transmit them and the printer
+ * thread prints them. The stages are connected by rings, so the transmitter
+ * always has the next message at hand, whatever a slow producer on our input
+ * or a slow terminal on our output are up to. The printer comes after the
+ * transmitter, so a message is never printed before it's sent.
+ *
+ * A stage waiting for another one sleeps on an eventfd, so it wakes up the
+ * moment there's something to do. It raises a flag before it goes to sleep and
+ * only if that flag is up the other stage bothers to wake it, so while nobody
+ * waits no system call is made at all. While we (the transmitter) wait, we
+ * keep an eye on the file descriptor given to pipelineWatch() too. */
+
+/* The amount of messages every ring can hold. A message is --size bytes, so
+ * this costs hardly anything. */
+#define PIPELINE_RING_SLOTS 256
+
+struct pipelineMessage {
+	int line;
+	int size;
+	unsigned char data[];
+};
+
+struct pipelineWait {
+	atomic_int waiting;
+	int eventFd;
+	/* Is it us, the transmitter, who waits here? */
+	bool_t watched;
+};
+
+struct pipelineStage {
+	struct ring ring;
+	pthread_t thread;
+	bool_t running;
+	struct pipelineWait filled;
+	struct pipelineWait emptied;
+};
+
+static struct {
+	struct pipelineStage parser;
+	struct pipelineStage printer;
+	bool_t ended;
+	bool_t (*get)(void *,unsigned char *,int *,int);
+	void (*idle)(void);
+	void (*print)(unsigned char *,int);
+	void *data;
+	int watchFd;
+	void (*watch)(void *);
+} _pipeline={
+	.watchFd=-1,
+	.parser={.filled={.eventFd=-1},.emptied={.eventFd=-1}},
+	.printer={.filled={.eventFd=-1},.emptied={.eventFd=-1}}
+};
+
+/* Wait for the other stage to wake us, handing whatever happens to the file
+ * descriptor we watch to its call-back meanwhile. */
+static void pipelineWatched(struct pipelineWait *wait) {
+	struct pollfd pollFds[2];
+	pollFds[0].fd=wait->eventFd;
+	pollFds[0].events=POLLIN;
+	pollFds[1].fd=_pipeline.watchFd;
+	pollFds[1].events=POLLIN;
+	for(;;) {
+		if(poll(pollFds,2,-1)<0) {
+			if(errno==EINTR) {
+				continue;
+			}
+			return;
+		}
+		if(pollFds[1].revents&POLLIN) {
+			_pipeline.watch(NULL);
+		}
+		if(pollFds[0].revents&POLLIN) {
+			eventfd_t value;
+			eventfd_read(wait->eventFd,&value);
+			return;
+		}
+	}
+}
+
+/* Get a slot of the ring, waiting for it if there is none. Our flag goes up
+ * before we look again, so either we see the slot of the other stage or the
+ * other stage sees our flag. */
+static struct pipelineMessage *pipelineWaitFor(struct ring *ring,void *(*get)(struct ring *),struct pipelineWait *wait) {
+	struct pipelineMessage *message;
+	while((message=(struct pipelineMessage *)get(ring))==NULL) {
+		eventfd_t value;
+		atomic_store(&wait->waiting,1);
+		atomic_thread_fence(memory_order_seq_cst);
+		if((message=(struct pipelineMessage *)get(ring))!=NULL) {
+			atomic_store(&wait->waiting,0);
+			break;
+		}
+		if(boolIsSet(wait->watched)&&(_pipeline.watch!=NULL)) {
+			pipelineWatched(wait);
+		} else {
+			eventfd_read(wait->eventFd,&value);
+		}
+	}
+	return(message);
+}
+
+static void pipelineWake(struct pipelineWait *wait) {
+	atomic_thread_fence(memory_order_seq_cst);
+	if(atomic_exchange(&wait->waiting,0)!=0) {
+		eventfd_write(wait->eventFd,1);
+	}
+}
+
+static struct pipelineMessage *pipelineProduceGet(struct pipelineStage *stage) {
+	return(pipelineWaitFor(&stage->ring,ringProduceGet,&stage->emptied));
+}
+
+static void pipelineProduce(struct pipelineStage *stage) {
+	ringProduce(&stage->ring);
+	pipelineWake(&stage->filled);
+}
+
+static struct pipelineMessage *pipelineConsumeGet(struct pipelineStage *stage) {
+	return(pipelineWaitFor(&stage->ring,ringConsumeGet,&stage->filled));
+}
+
+static void pipelineConsume(struct pipelineStage *stage) {
+	ringConsume(&stage->ring);
+	pipelineWake(&stage->emptied);
+}
+
+/* Get all the messages of our input. The end of it is marked with a message
+ * without a size. */
+static void *pipelineParser(void *data) {
+	struct pipelineMessage *message;
+	int line;
+	statsSignalsBlock();
+	for(line=1;;line++) {
+		message=pipelineProduceGet(&_pipeline.parser);
+		if(boolIsNotSet(_pipeline.get(_pipeline.data,message->data,&message->size,line))) {
+			message->size=-1;
+			pipelineProduce(&_pipeline.parser);
+			break;
+		}
+		message->line=line;
+		pipelineProduce(&_pipeline.parser);
+	}
+	return(NULL);
+}
+
+static void *pipelinePrinter(void *data) {
+	struct pipelineMessage *message;
+	statsSignalsBlock();
+	while((message=pipelineConsumeGet(&_pipeline.printer))->size>=0) {
+		_pipeline.print(message->data,message->size);
+		pipelineConsume(&_pipeline.printer);
+	}
+	fflush(stdout);
+	return(NULL);
+}
+
+static enum pipelineRtrn pipelineStageStart(struct pipelineStage *stage,void *(*thread)(void *)) {
+	if(ringInitialize(&stage->ring,PIPELINE_RING_SLOTS,sizeof(struct pipelineMessage)+_jpnevulatorOptions.size)!=ringRtrnOk) {
+		return(pipelineRtrnMemory);
+	}
+	atomic_init(&stage->filled.waiting,0);
+	atomic_init(&stage->emptied.waiting,0);
+	/* We wait for the parser to fill its ring and the printer to empty its. */
+	if(stage==&_pipeline.parser) {
+		boolSet(stage->filled.watched);
+	} else {
+		boolSet(stage->emptied.watched);
+	}
+	stage->filled.eventFd=eventfd(0,EFD_CLOEXEC);
+	stage->emptied.eventFd=eventfd(0,EFD_CLOEXEC);
+	if((stage->filled.eventFd==-1)||(stage->emptied.eventFd==-1)) {
+		return(pipelineRtrnNotify);
+	}
+	if(pthread_create(&stage->thread,NULL,thread,NULL)!=0) {
+		return(pipelineRtrnThread);
+	}
+	boolSet(stage->running);
+	return(pipelineRtrnOk);
+}
+
+/* Keep an eye on the given file descriptor while we wait for the other stages,
+ * the call-back is called every time it becomes readable. */
+void pipelineWatch(int fd,void (*watch)(void *)) {
+	_pipeline.watchFd=fd;
+	_pipeline.watch=watch;
+}
+
+/* Start the parser, which gets its messages from the given function, and the
+ * printer if there's anything to print. Messages are never bigger than --size
+ * bytes. The idle function, if any, is called every time we have to wait for
+ * the parser. */
+enum pipelineRtrn pipelineStart(bool_t (*get)(void *,unsigned char *,int *,int),void *data,void (*idle)(void),void (*print)(unsigned char *,int)) {
+	enum pipelineRtrn rtrn;
+	_pipeline.get=get;
+	_pipeline.data=data;
+	_pipeline.idle=idle;
+	_pipeline.print=print;
+	boolReset(_pipeline.ended);
+	if((print!=NULL)&&((rtrn=pipelineStageStart(&_pipeline.printer,pipelinePrinter))!=pipelineRtrnOk)) {
+		return(rtrn);
+	}
+	return(pipelineStageStart(&_pipeline.parser,pipelineParser));
+}
+
+/* Wait for the next message of the parser. The message stays ours until we're
+ * done with it. Returns false at the end of our input. */
+bool_t pipelineNext(unsigned char **data,int *size,int *line) {
+	struct pipelineMessage *message;
+	if(((message=(struct pipelineMessage *)ringConsumeGet(&_pipeline.parser.ring))==NULL)&&(_pipeline.idle!=NULL)) {
+		_pipeline.idle();
+	}
+	if(message==NULL) {
+		message=pipelineConsumeGet(&_pipeline.parser);
+	}
+	if(message->size<0) {
+		boolSet(_pipeline.ended);
+		return(boolFalse);
+	}
+	*data=message->data;
+	*size=message->size;
+	*line=message->line;
+	return(boolTrue);
+}
+
+void pipelineDone(void) {
+	pipelineConsume(&_pipeline.parser);
+}
+
+bool_t pipelinePrinting(void) {
+	return(_pipeline.printer.running);
+}
+
+/* Hand a message over to the printer. A message without a size tells it to
+ * stop. */
+void pipelinePrint(unsigned char *data,int size) {
+	struct pipelineMessage *message;
+	message=pipelineProduceGet(&_pipeline.printer);
+	if(size>0) {
+		memcpy(message->data,data,size);
+	}
+	message->size=size;
+	pipelineProduce(&_pipeline.printer);
+}
+
+static void pipelineStageStop(struct pipelineStage *stage) {
+	if(boolIsSet(stage->running)) {
+		pthread_join(stage->thread,NULL);
+		boolReset(stage->running);
+	}
+	if(stage->filled.eventFd!=-1) {
+		close(stage->filled.eventFd);
+		stage->filled.eventFd=-1;
+	}
+	if(stage->emptied.eventFd!=-1) {
+		close(stage->emptied.eventFd);
+		stage->emptied.eventFd=-1;
+	}
+	ringDestroy(&stage->ring);
+}
+
+/* Let the printer finish whatever it's got and stop the parser, which is only
+ * still running if we did not get to the end of our input. */
+void pipelineStop(void) {
+	if(boolIsSet(_pipeline.printer.running)) {
+		pipelinePrint(NULL,-1);
+	}
+	pipelineStageStop(&_pipeline.printer);
+	if(boolIsSet(_pipeline.parser.running)&&boolIsNotSet(_pipeline.ended)) {
+		pthread_cancel(_pipeline.parser.thread);
+	}
+	pipelineStageStop(&_pipeline.parser);
+}
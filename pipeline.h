@@ -0,0 +1,38 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef __PIPELINE_H
+#define __PIPELINE_H
+
+#include "misc.h"
+
+enum pipelineRtrn {
+	pipelineRtrnOk=0,
+	pipelineRtrnMemory,
+	pipelineRtrnNotify,
+	pipelineRtrnThread
+};
+
+extern void pipelineWatch(int,void (*)(void *));
+extern enum pipelineRtrn pipelineStart(bool_t (*)(void *,unsigned char *,int *,int),void *,void (*)(void),void (*)(unsigned char *,int));
+extern bool_t pipelineNext(unsigned char **,int *,int *);
+extern void pipelineDone(void);
+extern bool_t pipelinePrinting(void);
+extern void pipelinePrint(unsigned char *,int);
+extern void pipelineStop(void);
+
+#endif
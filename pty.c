@@ -23,25 +23,29 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
+#include <errno.h>
 
 #include "jpnevulator.h"
 #include "interface.h"
 #include "pty.h"
 
-static int ptyOpen(char *name,int length) {
+/* A pty is named after its slave device, which we only know once opened. If we
+ * can't get hold of that name, the pty keeps the one it was given. */
+static int ptyOpen(char **name) {
 	int fd;
 	fd=posix_openpt(O_RDWR);
 	if(fd!=-1) {
-		char *pts;
-		int charactersPrinted;
+		char *pts,*interned;
 		grantpt(fd);
 		unlockpt(fd);
 		pts=ptsname(fd);
 		fprintf(stderr,"%s: slave pts device is %s.\n",PROGRAM_NAME,pts);
-		charactersPrinted=sprintf(name,"%.*s",length,pts);
-		if(charactersPrinted!=strlen(name)) {
-			fprintf(stderr,"%s: interface %s truncated to %d chars -> %s\n",PROGRAM_NAME,pts,charactersPrinted,name);
+		if((interned=interfaceIntern(pts))==NULL) {
+			close(fd);
+			errno=ENOMEM;
+			return(-1);
 		}
+		*name=interned;
 	}
 	return(fd);
 }
@@ -0,0 +1,271 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+
+#include "jpnevulator.h"
+#include "interface.h"
+#include "reactor.h"
+#include "stats.h"
+#include "queue.h"
+
+/* Are we running under the reactor? If so it tells us when a queue can be
+ * written again, otherwise somebody needs to call queueFlush() now and then. */
+static bool_t _reactor=boolFalse;
+
+/* Give every interface a queue of its own. From now on nobody waits for an
+ * interface to take its bytes, unless the user likes us to. */
+enum queueRtrn queueInitialize(bool_t reactor) {
+	struct interface *interface;
+	int id;
+	_reactor=reactor;
+	for(id=0;id<interfaceCount();id++) {
+		struct queue *queue;
+		interface=interfaceGet(id);
+		queue=(struct queue *)calloc(1,sizeof(struct queue));
+		if(queue==NULL) {
+			return(queueRtrnMemory);
+		}
+		interface->queue=queue;
+		fcntl(interface->fd,F_SETFL,fcntl(interface->fd,F_GETFL)|O_NONBLOCK);
+		queue->size=_jpnevulatorOptions.queueSize;
+		queue->data=(unsigned char *)malloc(queue->size);
+		if(queue->data==NULL) {
+			return(queueRtrnMemory);
+		}
+	}
+	return(queueRtrnOk);
+}
+
+/* Throw away the given amount of the oldest bytes. */
+static void queueDrop(struct queue *queue,size_t size) {
+	queue->head=(queue->head+size)%queue->size;
+	queue->length-=size;
+	queue->dropped+=size;
+}
+
+/* Write as much of the queue as the interface is willing to take right now.
+ * An interface in real trouble loses its whole queue, there is no point in
+ * keeping it around. Only now the bytes really are written, so only now they
+ * are counted. */
+static void queueFlushOne(struct interface *interface) {
+	struct queue *queue;
+	queue=interface->queue;
+	while(queue->length>0) {
+		ssize_t n;
+		n=write(interface->fd,&(queue->data[queue->head]),min(queue->length,queue->size-queue->head));
+		if(n>0) {
+			statsWrite(interface,n);
+			queue->head=(queue->head+n)%queue->size;
+			queue->length-=n;
+		} else if((n<0)&&(errno==EINTR)) {
+			continue;
+		} else {
+			if((n<0)&&(errno!=EAGAIN)) {
+				statsWrite(interface,n);
+				fprintf(stderr,"%s: %s: write of %ld queued bytes failed(%ld).\n",PROGRAM_NAME,interfacePrint(interface),(long)queue->length,(long)n);
+				queueDrop(queue,queue->length);
+			}
+			break;
+		}
+	}
+}
+
+/* Called by the reactor once an interface with a queue can be written again. */
+static void queueWritable(void *data) {
+	struct interface *interface;
+	interface=(struct interface *)data;
+	queueFlushOne(interface);
+	if(interface->queue->length==0) {
+		reactorWritable(interface->fd,&interface->reactor,NULL,NULL);
+		boolReset(interface->queue->watched);
+	}
+}
+
+/* Wait until the interface is able to take some bytes again and give them. */
+static void queueWait(struct interface *interface) {
+	struct pollfd pollFd;
+	pollFd.fd=interface->fd;
+	pollFd.events=POLLOUT;
+	if((poll(&pollFd,1,-1)<0)&&(errno!=EINTR)) {
+		/* No way to ever get rid of our bytes. */
+		queueDrop(interface->queue,interface->queue->length);
+		return;
+	}
+	queueFlushOne(interface);
+}
+
+/* Put the given bytes in the queue, making room for them the way the user likes us
+ * to. Returns the amount of bytes that made it into the queue. */
+static size_t queuePut(struct interface *interface,unsigned char *data,size_t size) {
+	struct queue *queue;
+	size_t queued;
+	queue=interface->queue;
+	queued=0;
+	while(size>0) {
+		size_t room,tail,part;
+		room=queue->size-queue->length;
+		if(room==0) {
+			switch(_jpnevulatorOptions.queuePolicy) {
+				case queuePolicyDropNewest: {
+					queue->dropped+=size;
+					return(queued);
+				}
+				case queuePolicyDropOldest: {
+					/* No need to keep anything that gets pushed out by these
+					 * bytes anyway. */
+					if(size>queue->size) {
+						queue->dropped+=size-queue->size;
+						data+=size-queue->size;
+						size=queue->size;
+					}
+					queueDrop(queue,min(size,queue->length));
+					break;
+				}
+				case queuePolicyBlock:
+				default: {
+					queueWait(interface);
+					break;
+				}
+			}
+			continue;
+		}
+		tail=(queue->head+queue->length)%queue->size;
+		part=min(min(size,room),queue->size-tail);
+		memcpy(&(queue->data[tail]),data,part);
+		queue->length+=part;
+		queue->queued+=part;
+		queued+=part;
+		data+=part;
+		size-=part;
+	}
+	return(queued);
+}
+
+/* Write the given bytes to the interface without ever waiting for it, unless the
+ * user asked us to. Whatever the interface can't take right now is queued and
+ * written as soon as it can. Returns the amount of bytes written or queued, so
+ * without the ones dropped, and -1 if the interface is in trouble. The statistics
+ * only count the bytes that really were written, queued bytes are counted once
+ * they leave the queue. */
+ssize_t queueWrite(struct interface *interface,unsigned char *data,size_t size) {
+	struct queue *queue;
+	ssize_t n,written;
+	size_t queued;
+	queue=interface->queue;
+	if(queue==NULL) {
+		n=write(interface->fd,data,size);
+		statsWrite(interface,n);
+		return(n);
+	}
+	/* Only write directly if nobody is waiting in line before us. */
+	if(queue->length==0) {
+		do {
+			n=write(interface->fd,data,size);
+		} while((n<0)&&(errno==EINTR));
+		if(n<0) {
+			if(errno!=EAGAIN) {
+				statsWrite(interface,n);
+				return(n);
+			}
+			n=0;
+		}
+		if(n>0) {
+			statsWrite(interface,n);
+		}
+		if(n==size) {
+			return(n);
+		}
+		data+=n;
+		size-=n;
+		written=n;
+	} else {
+		written=0;
+	}
+	queued=queuePut(interface,data,size);
+	if(boolIsSet(_reactor)&&(queue->length>0)&&boolIsNotSet(queue->watched)) {
+		if(reactorWritable(interface->fd,&interface->reactor,queueWritable,(void *)interface)==reactorRtrnOk) {
+			boolSet(queue->watched);
+		}
+	}
+	return(written+queued);
+}
+
+/* Write as much of all queues as possible, without waiting. */
+void queueFlush(void) {
+	struct interface *interface;
+	int id;
+	for(id=0;id<interfaceCount();id++) {
+		interface=interfaceGet(id);
+		if((interface->queue!=NULL)&&(interface->queue->length>0)) {
+			queueFlushOne(interface);
+		}
+	}
+}
+
+/* Wait until all queues are written. */
+void queueDrain(void) {
+	struct interface *interface;
+	int id;
+	for(id=0;id<interfaceCount();id++) {
+		interface=interfaceGet(id);
+		if(interface->queue!=NULL) {
+			while(interface->queue->length>0) {
+				queueWait(interface);
+			}
+		}
+	}
+}
+
+/* Tell about every interface that had to drop bytes. Whatever is still in the
+ * queue by now will never make it to the interface, so it's dropped too. */
+void queueReport(FILE *output) {
+	struct interface *interface;
+	int id;
+	for(id=0;id<interfaceCount();id++) {
+		interface=interfaceGet(id);
+		if((interface->queue!=NULL)&&((interface->queue->dropped+interface->queue->length)>0)) {
+			fprintf(
+				output,
+				"%s: %s: %llu bytes dropped, %llu bytes had to be queued.\n",
+				PROGRAM_NAME,interfacePrint(interface),
+				interface->queue->dropped+interface->queue->length,interface->queue->queued
+			);
+		}
+	}
+}
+
+void queueDestroy(void) {
+	struct interface *interface;
+	int id;
+	for(id=0;id<interfaceCount();id++) {
+		interface=interfaceGet(id);
+		if(interface->queue!=NULL) {
+			free(interface->queue->data);
+			free(interface->queue);
+			interface->queue=NULL;
+		}
+	}
+	_reactor=boolFalse;
+}
@@ -0,0 +1,59 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __QUEUE_H
+#define __QUEUE_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "misc.h"
+#include "interface.h"
+
+/* What to do if the outbound queue of an interface is full. */
+enum queuePolicy {
+	queuePolicyBlock=0,
+	queuePolicyDropOldest,
+	queuePolicyDropNewest
+};
+
+/* The bytes waiting to be written to an interface that is not able to take them
+ * right now. A ring of bytes, head points to the oldest one. */
+struct queue {
+	unsigned char *data;
+	size_t size;
+	size_t head;
+	size_t length;
+	unsigned long long queued;
+	unsigned long long dropped;
+	bool_t watched;
+};
+
+enum queueRtrn {
+	queueRtrnOk=0,
+	queueRtrnMemory
+};
+
+extern enum queueRtrn queueInitialize(bool_t);
+extern ssize_t queueWrite(struct interface *,unsigned char *,size_t);
+extern void queueFlush(void);
+extern void queueDrain(void);
+extern void queueReport(FILE *);
+extern void queueDestroy(void);
+
+#endif
@@ -0,0 +1,190 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+
+#include "reactor.h"
+#include "list.h"
+
+/* The maximum amount of events we handle in one go. Whatever is left
+ * will be reported by the kernel during the next call to reactorWait(). */
+#define REACTOR_EVENTS 64
+
+struct reactorHandler {
+	int fd;
+	void (*callback)(void *);
+	void (*writable)(void *);
+	void *data;
+	void *writableData;
+	int polled;
+};
+
+static int _epollFd=-1;
+static list_t _handlers;
+static int _handlersPolled;
+
+enum reactorRtrn reactorInitialize(void) {
+	listInitialize(&_handlers);
+	_handlersPolled=0;
+	_epollFd=epoll_create1(EPOLL_CLOEXEC);
+	if(_epollFd==-1) {
+		return(reactorRtrnCreate);
+	}
+	return(reactorRtrnOk);
+}
+
+/* Register a file descriptor with the reactor. From now on the call-back, if any,
+ * is called with the given data every time the file descriptor becomes readable.
+ * The kernel refuses to watch regular files, which select() always reported as
+ * readable. So to keep on behaving like we always did, those are put aside and
+ * simply called every time we wait. If asked for, the handler is handed back,
+ * so it can be given to reactorWritable() later on. */
+enum reactorRtrn reactorAdd(int fd,void (*callback)(void *),void *data,struct reactorHandler **handlerAdded) {
+	struct reactorHandler *handler;
+	struct epoll_event event;
+	handler=(struct reactorHandler *)malloc(sizeof(struct reactorHandler));
+	if(handler==NULL) {
+		return(reactorRtrnMemory);
+	}
+	handler->fd=fd;
+	handler->callback=callback;
+	handler->writable=NULL;
+	handler->data=data;
+	handler->writableData=NULL;
+	handler->polled=0;
+	event.events=callback!=NULL?EPOLLIN:0;
+	event.data.ptr=handler;
+	if(epoll_ctl(_epollFd,EPOLL_CTL_ADD,fd,&event)==-1) {
+		if(errno!=EPERM) {
+			free(handler);
+			return(reactorRtrnAdd);
+		}
+		handler->polled=1;
+		_handlersPolled++;
+	}
+	if(listAppend(&_handlers,(void *)handler)!=listRtrnOk) {
+		/* Make sure the kernel forgets about it too, before it's gone. */
+		if(handler->polled) {
+			_handlersPolled--;
+		} else {
+			epoll_ctl(_epollFd,EPOLL_CTL_DEL,fd,NULL);
+		}
+		free(handler);
+		return(reactorRtrnMemory);
+	}
+	listNext(&_handlers);
+	if(handlerAdded!=NULL) {
+		*handlerAdded=handler;
+	}
+	return(reactorRtrnOk);
+}
+
+/* Ask the reactor to call the given call-back with the given data every time the
+ * file descriptor becomes writable. Give no call-back to stop this again. The file
+ * descriptor does not need to be registered for reading. The handler it was
+ * registered with is given, if there is none yet one is registered and handed
+ * back, so there is never a need to look for it. A file descriptor the kernel
+ * refuses to watch is always writable, so it won't ever need this. */
+enum reactorRtrn reactorWritable(int fd,struct reactorHandler **handlerAdded,void (*writable)(void *),void *data) {
+	struct reactorHandler *handler;
+	struct epoll_event event;
+	if((*handlerAdded==NULL)&&(writable!=NULL)) {
+		/* We might be called from within a call-back while reactorWait() walks our
+		 * handlers, so leave its position alone. */
+		struct listElement *position;
+		position=listCurrentPositionSave(&_handlers);
+		reactorAdd(fd,NULL,NULL,handlerAdded);
+		listCurrentPositionLoad(&_handlers,position);
+	}
+	handler=*handlerAdded;
+	if(handler==NULL) {
+		return(writable!=NULL?reactorRtrnAdd:reactorRtrnOk);
+	}
+	if(handler->polled) {
+		return(reactorRtrnOk);
+	}
+	handler->writable=writable;
+	handler->writableData=data;
+	event.events=(handler->callback!=NULL?EPOLLIN:0)|(writable!=NULL?EPOLLOUT:0);
+	event.data.ptr=handler;
+	if(epoll_ctl(_epollFd,EPOLL_CTL_MOD,fd,&event)==-1) {
+		return(reactorRtrnAdd);
+	}
+	return(reactorRtrnOk);
+}
+
+/* Wait at most the given amount of microseconds (or forever if none is given) for
+ * any of the registered file descriptors to become readable and call the call-back
+ * of each one that did. Since epoll only knows about milliseconds we round up, so
+ * we never return earlier than asked for. Returns the amount of call-backs called,
+ * zero on a timeout and -1 on an error. */
+int reactorWait(unsigned long *timeout) {
+	struct epoll_event events[REACTOR_EVENTS];
+	int timeoutMs;
+	int rtrn;
+	int index;
+	if(_handlersPolled>0) {
+		timeoutMs=0;
+	} else if(timeout!=NULL) {
+		timeoutMs=(*timeout+999UL)/1000UL;
+	} else {
+		timeoutMs=-1;
+	}
+	rtrn=epoll_wait(_epollFd,events,REACTOR_EVENTS,timeoutMs);
+	if(rtrn==-1) {
+		return(-1);
+	}
+	for(index=0;index<rtrn;index++) {
+		struct reactorHandler *handler;
+		handler=(struct reactorHandler *)events[index].data.ptr;
+		if((handler->callback!=NULL)&&(events[index].events&(EPOLLIN|EPOLLHUP|EPOLLERR))) {
+			handler->callback(handler->data);
+		}
+		if((handler->writable!=NULL)&&(events[index].events&(EPOLLOUT|EPOLLHUP|EPOLLERR))) {
+			handler->writable(handler->writableData);
+		}
+	}
+	if(_handlersPolled>0) {
+		struct reactorHandler *handler;
+		if((handler=(struct reactorHandler *)listFirst(&_handlers))!=NULL) {
+			do {
+				if(handler->polled&&(handler->callback!=NULL)) {
+					handler->callback(handler->data);
+					rtrn++;
+				}
+			} while((handler=(struct reactorHandler *)listNext(&_handlers))!=NULL);
+		}
+	}
+	return(rtrn);
+}
+
+static void garbageCollect(void *data) {
+	free(data);
+}
+
+void reactorDestroy(void) {
+	listDestroy(&_handlers,garbageCollect);
+	if(_epollFd!=-1) {
+		close(_epollFd);
+		_epollFd=-1;
+	}
+}
@@ -0,0 +1,37 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __REACTOR_H
+#define __REACTOR_H
+
+struct reactorHandler;
+
+enum reactorRtrn {
+	reactorRtrnOk=0,
+	reactorRtrnCreate,
+	reactorRtrnMemory,
+	reactorRtrnAdd
+};
+
+extern enum reactorRtrn reactorInitialize(void);
+extern enum reactorRtrn reactorAdd(int,void (*)(void *),void *,struct reactorHandler **);
+extern enum reactorRtrn reactorWritable(int,struct reactorHandler **,void (*)(void *),void *);
+extern int reactorWait(unsigned long *);
+extern void reactorDestroy(void);
+
+#endif
@@ -0,0 +1,257 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "jpnevulator.h"
+#include "interface.h"
+#include "reactor.h"
+#include "ring.h"
+#include "timestamp.h"
+#include "stats.h"
+#include "reader.h"
+
+/* The amount of chunks every reader thread can have waiting for the formatter, at
+ * most and at least. Together all rings never take more than READER_RING_BYTES,
+ * so with lots of interfaces every one of them gets less slots and if that's not
+ * enough smaller chunks, but never smaller than READER_CHUNK_MIN bytes. */
+#define READER_RING_SLOTS 16
+#define READER_RING_SLOTS_MIN 2
+#define READER_RING_BYTES (16*1024*1024)
+#define READER_CHUNK_MIN 4096
+/* The amount of microseconds a reader thread waits for the formatter to make
+ * some room in its ring. The kernel keeps on buffering meanwhile. */
+#define READER_RING_FULL_WAIT 1000
+/* The amount of microseconds a chunk is held back so a chunk from another
+ * interface, that was read just before it but pushed just after it, still
+ * gets a fair chance to be displayed first. */
+#define READER_REORDER_WINDOW 2000L
+
+struct readerChunk {
+	struct timestamp time;
+	ssize_t size;
+	unsigned char data[];
+};
+
+struct reader {
+	struct interface *interface;
+	struct ring ring;
+	/* The amount of bytes read at once, never more than --buffer-size. */
+	size_t chunkSize;
+	pthread_t thread;
+	bool_t running;
+};
+
+static struct reader *_readers=NULL;
+static int _readersCount=0;
+static int _eventFd=-1;
+static int _timerFd=-1;
+static void (*_handler)(struct interface *,struct timestamp *,unsigned char *,ssize_t);
+
+/* This is where every reader thread spends its life. It reads whatever its interface
+ * has got to offer, stamps it with the time and pushes it into its own ring. It never
+ * waits for anything else than its interface, unless the formatter really can't keep
+ * up and the ring is full. */
+static void *readerThread(void *data) {
+	struct reader *reader;
+	reader=(struct reader *)data;
+	statsSignalsBlock();
+	for(;;) {
+		struct readerChunk *chunk;
+		ssize_t bytesRead;
+		while((chunk=(struct readerChunk *)ringProduceGet(&reader->ring))==NULL) {
+			usleep(READER_RING_FULL_WAIT);
+		}
+		bytesRead=read(reader->interface->fd,chunk->data,reader->chunkSize);
+		if(bytesRead>0) {
+			timestampGet(&chunk->time);
+			chunk->size=bytesRead;
+			ringProduce(&reader->ring);
+			eventfd_write(_eventFd,1);
+		} else if((bytesRead<0)&&(errno==EAGAIN)) {
+			/* Our interface does not block, wait for it ourself. */
+			struct pollfd pollFd;
+			pollFd.fd=reader->interface->fd;
+			pollFd.events=POLLIN;
+			poll(&pollFd,1,-1);
+		} else if((bytesRead==0)||(errno!=EINTR)) {
+			/* Nothing to read or the interface is in trouble, like a pty without
+			 * anybody on the other side. Don't burn the CPU while waiting. */
+			usleep(READER_RING_FULL_WAIT);
+		}
+	}
+	return(NULL);
+}
+
+/* Search for the reader with the oldest chunk waiting. That chunk is only handed
+ * out if it can not be overtaken anymore, which is when all the other readers
+ * have a chunk waiting too or when it is older than our reorder window. If a
+ * chunk is held back, wait tells how many microseconds it will take to mature. */
+static struct reader *readerOldest(long *wait) {
+	struct reader *oldest;
+	struct readerChunk *oldestChunk;
+	struct timestamp now;
+	long age;
+	int waiting;
+	int index;
+	*wait=0;
+	oldest=NULL;
+	oldestChunk=NULL;
+	for(index=0,waiting=0;index<_readersCount;index++) {
+		struct readerChunk *chunk;
+		if((chunk=(struct readerChunk *)ringConsumeGet(&_readers[index].ring))!=NULL) {
+			waiting++;
+			if((oldestChunk==NULL)||(timestampDiff(&chunk->time,&oldestChunk->time)<0)) {
+				oldest=&_readers[index];
+				oldestChunk=chunk;
+			}
+		}
+	}
+	if((oldest==NULL)||(waiting==_readersCount)) {
+		return(oldest);
+	}
+	timestampGet(&now);
+	age=timestampDiff(&now,&oldestChunk->time)/1000L;
+	if(age>=READER_REORDER_WINDOW) {
+		return(oldest);
+	}
+	*wait=READER_REORDER_WINDOW-age;
+	return(NULL);
+}
+
+/* Hand out all the chunks that are ready to our handler, in order of time. */
+static void readerDrain(void) {
+	struct reader *reader;
+	long wait;
+	while((reader=readerOldest(&wait))!=NULL) {
+		struct readerChunk *chunk;
+		chunk=(struct readerChunk *)ringConsumeGet(&reader->ring);
+		_handler(reader->interface,&chunk->time,chunk->data,chunk->size);
+		ringConsume(&reader->ring);
+	}
+	/* Something is held back? Make sure we come back for it. */
+	if(wait>0) {
+		struct itimerspec timer;
+		memset(&timer,0,sizeof(timer));
+		timer.it_value.tv_sec=wait/1000000L;
+		timer.it_value.tv_nsec=(wait%1000000L)*1000L;
+		timerfd_settime(_timerFd,0,&timer,NULL);
+	}
+}
+
+static void readerNotified(void *data) {
+	eventfd_t value;
+	eventfd_read(_eventFd,&value);
+	readerDrain();
+}
+
+static void readerMatured(void *data) {
+	uint64_t expirations;
+	if(read(_timerFd,&expirations,sizeof(expirations))>0) {
+		readerDrain();
+	}
+}
+
+/* Start one reader thread for every interface. Whatever they read will be handed to
+ * the given handler from within the reactor, in the order it was read. */
+enum readerRtrn readerStart(void (*handler)(struct interface *,struct timestamp *,unsigned char *,ssize_t)) {
+	struct interface *interface;
+	size_t budget,chunkSize;
+	int slots;
+	int id;
+	int index;
+	_handler=handler;
+	_readersCount=0;
+	_readers=(struct reader *)calloc(interfaceCount(),sizeof(struct reader));
+	if(_readers==NULL) {
+		return(readerRtrnMemory);
+	}
+	/* Share our memory among all interfaces. Less slots first, since a single
+	 * big read is worth more than a few small ones. */
+	budget=READER_RING_BYTES/max(1,interfaceCount());
+	chunkSize=_jpnevulatorOptions.bufferSize;
+	slots=budget/(sizeof(struct readerChunk)+chunkSize);
+	slots=max(READER_RING_SLOTS_MIN,min(READER_RING_SLOTS,slots));
+	if((slots*(sizeof(struct readerChunk)+chunkSize))>budget) {
+		chunkSize=READER_CHUNK_MIN;
+		if((budget/slots)>(sizeof(struct readerChunk)+READER_CHUNK_MIN)) {
+			chunkSize=(budget/slots)-sizeof(struct readerChunk);
+		}
+		chunkSize=min(chunkSize,(size_t)_jpnevulatorOptions.bufferSize);
+	}
+	for(id=0;id<interfaceCount();id++) {
+		interface=interfaceGet(id);
+		_readers[_readersCount].interface=interface;
+		_readers[_readersCount].chunkSize=chunkSize;
+		if(ringInitialize(&_readers[_readersCount].ring,slots,sizeof(struct readerChunk)+chunkSize)!=ringRtrnOk) {
+			return(readerRtrnMemory);
+		}
+		_readersCount++;
+	}
+	_eventFd=eventfd(0,EFD_CLOEXEC|EFD_NONBLOCK);
+	_timerFd=timerfd_create(CLOCK_MONOTONIC,TFD_CLOEXEC|TFD_NONBLOCK);
+	if((_eventFd==-1)||(_timerFd==-1)) {
+		return(readerRtrnNotify);
+	}
+	if(
+		(reactorAdd(_eventFd,readerNotified,NULL,NULL)!=reactorRtrnOk)||
+		(reactorAdd(_timerFd,readerMatured,NULL,NULL)!=reactorRtrnOk)
+	) {
+		return(readerRtrnNotify);
+	}
+	for(index=0;index<_readersCount;index++) {
+		if(pthread_create(&_readers[index].thread,NULL,readerThread,(void *)&_readers[index])!=0) {
+			return(readerRtrnThread);
+		}
+		boolSet(_readers[index].running);
+	}
+	return(readerRtrnOk);
+}
+
+void readerStop(void) {
+	int index;
+	if(_readers==NULL) {
+		return;
+	}
+	for(index=0;index<_readersCount;index++) {
+		if(boolIsSet(_readers[index].running)) {
+			pthread_cancel(_readers[index].thread);
+			pthread_join(_readers[index].thread,NULL);
+		}
+		ringDestroy(&_readers[index].ring);
+	}
+	free(_readers);
+	_readers=NULL;
+	_readersCount=0;
+	if(_eventFd!=-1) {
+		close(_eventFd);
+		_eventFd=-1;
+	}
+	if(_timerFd!=-1) {
+		close(_timerFd);
+		_timerFd=-1;
+	}
+}
@@ -0,0 +1,320 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "jpnevulator.h"
+#include "interface.h"
+#include "byte.h"
+#include "pace.h"
+#include "replay.h"
+
+/* Replay what we once captured in read mode, the way we captured it. The input
+ * is our own text output, so a line is one of:
+ *
+ *   a header      "2024-01-01 12:00:00.123456: name" (--timing-print), the
+ *                 name only if more than one interface was read. The nano
+ *                 and delta (+1.000000:) timing styles are understood too.
+ *   a name        "name", the interface switched without a header.
+ *   control bits  "le=0, dtr=1, ...", of no use to us.
+ *   data          "[count\t]68 65 6C 6C 6F[\tascii]", the bytes to send.
+ *
+ * The data following a header is sent the moment the header says it was read,
+ * scaled by --replay, counted from the first header. The interface it was read
+ * from is mapped onto one of ours: the one with the same name or alias or else
+ * the next one without an alias not used yet, in the order given. Data without an interface
+ * name goes out on all of our interfaces. */
+
+struct replayMap {
+	char *name;
+	struct interface *interface;
+};
+
+static struct {
+	struct replayMap *map;
+	int mapCount;
+	/* The interface we are replaying the data of right now, NULL for all. Skip
+	 * the data of a captured interface we have no interface left for. */
+	struct interface *interface;
+	bool_t skip;
+	bool_t timed;
+	long long previous;
+	unsigned char *data;
+	size_t dataSize;
+} _replay;
+
+#define REPLAY_NSEC_PER_SEC 1000000000LL
+
+/* Read the fraction of a second at the given position, up to the nanosecond.
+ * Returns the amount of characters read. */
+static int replayFraction(const char *position,long long *nanoseconds) {
+	long long scale;
+	int length;
+	*nanoseconds=0LL;
+	scale=REPLAY_NSEC_PER_SEC;
+	for(length=0;isdigit((unsigned char)position[length]);length++) {
+		if(scale>1LL) {
+			scale/=10LL;
+			*nanoseconds+=(position[length]-'0')*scale;
+		}
+	}
+	return(length);
+}
+
+/* Is this a header? If so, return the moment it tells about in nanoseconds and
+ * where the interface name starts, if any. */
+static int replayHeader(char *line,long long *time,char **name) {
+	long long fraction;
+	char *position;
+	if(line[0]=='+') {
+		long long seconds;
+		seconds=strtoll(line+1,&position,10);
+		if((position==line+1)||(*position!='.')) {
+			return(0);
+		}
+		position++;
+		position+=replayFraction(position,&fraction);
+		*time=_replay.previous+(seconds*REPLAY_NSEC_PER_SEC)+fraction;
+	} else {
+		struct tm tm;
+		int length;
+		memset(&tm,0,sizeof(tm));
+		length=0;
+		if(
+			(sscanf(line,"%4d-%2d-%2d %2d:%2d:%2d.%n",&tm.tm_year,&tm.tm_mon,&tm.tm_mday,&tm.tm_hour,&tm.tm_min,&tm.tm_sec,&length)!=6)||
+			(length==0)
+		) {
+			return(0);
+		}
+		tm.tm_year-=1900;
+		tm.tm_mon-=1;
+		tm.tm_isdst=-1;
+		position=line+length;
+		position+=replayFraction(position,&fraction);
+		*time=((long long)mktime(&tm)*REPLAY_NSEC_PER_SEC)+fraction;
+	}
+	if(*position!=':') {
+		return(0);
+	}
+	position++;
+	*name=*position==' '?position+1:NULL;
+	return(1);
+}
+
+/* Decode the bytes in the given text. Returns the amount of bytes or -1 if
+ * it's not all bytes. */
+static int replayBytes(char *text,unsigned char *data) {
+	char *token,*end;
+	int width,length;
+	width=byteWidth(_jpnevulatorOptions.base);
+	length=0;
+	for(token=text;*token!='\0';) {
+		long byte;
+		if(*token==' ') {
+			token++;
+			continue;
+		}
+		byte=strtol(token,&end,_jpnevulatorOptions.base);
+		if((end-token!=width)||((*end!=' ')&&(*end!='\0'))||(byte<0)||(byte>0xFF)) {
+			return(-1);
+		}
+		data[length++]=byte;
+		token=end;
+	}
+	return(length>0?length:-1);
+}
+
+/* Is this a data line? The byte count in front and the ascii data at the end
+ * are separated from the bytes by a tab, if present. */
+static int replayData(char *line) {
+	char *fields[3];
+	int count,length;
+	for(count=1,fields[0]=line;count<3;count++) {
+		if((fields[count]=strchr(fields[count-1],'\t'))==NULL) {
+			break;
+		}
+		*(fields[count]++)='\0';
+	}
+	if(count==3) {
+		return(replayBytes(fields[1],_replay.data));
+	}
+	/* Two fields is a byte count and the bytes or the bytes and the ascii data. */
+	if((count==2)&&(strlen(fields[0])==8)&&(strspn(fields[0],"0123456789ABCDEFabcdef")==8)) {
+		if((length=replayBytes(fields[1],_replay.data))>0) {
+			return(length);
+		}
+	}
+	return(replayBytes(fields[0],_replay.data));
+}
+
+/* Find the interface of ours to send the data of the given captured interface on. */
+static struct interface *replayInterface(char *name) {
+	struct interface *interface;
+	int id;
+	struct replayMap *map;
+	int index;
+	for(index=0;index<_replay.mapCount;index++) {
+		if(strcmp(_replay.map[index].name,name)==0) {
+			return(_replay.map[index].interface);
+		}
+	}
+	/* A new one. One of ours with the same name or alias? */
+	interface=NULL;
+	for(id=0;(interface==NULL)&&(id<interfaceCount());id++) {
+		if((strcmp(interfaceName(interfaceGet(id)),name)==0)||(strcmp(interfaceAlias(interfaceGet(id)),name)==0)) {
+			interface=interfaceGet(id);
+		}
+	}
+	/* Otherwise the first one nobody uses yet. One with an alias is kept for
+	 * the captured interface of that name, which might still show up. */
+	for(id=0;(interface==NULL)&&(id<interfaceCount());id++) {
+		for(index=0;(index<_replay.mapCount)&&(_replay.map[index].interface!=interfaceGet(id));index++);
+		if((index==_replay.mapCount)&&(strlen(interfaceAlias(interfaceGet(id)))==0)) {
+			interface=interfaceGet(id);
+		}
+	}
+	map=(struct replayMap *)realloc(_replay.map,(_replay.mapCount+1)*sizeof(struct replayMap));
+	if(map==NULL) {
+		return(NULL);
+	}
+	_replay.map=map;
+	if((_replay.map[_replay.mapCount].name=strdup(name))==NULL) {
+		return(NULL);
+	}
+	_replay.map[_replay.mapCount].interface=interface;
+	_replay.mapCount++;
+	if(interface==NULL) {
+		fprintf(stderr,"%s: No interface left to replay %s on, skipping its data.\n",PROGRAM_NAME,name);
+	} else if((strcmp(interfaceName(interface),name)!=0)&&(strcmp(interfaceAlias(interface),name)!=0)) {
+		fprintf(stderr,"%s: Replaying %s on %s.\n",PROGRAM_NAME,name,interfacePrint(interface));
+	}
+	return(interface);
+}
+
+/* Switch to the interface of ours the given captured interface is mapped onto. */
+static void replaySwitch(char *name) {
+	if(name==NULL) {
+		_replay.interface=NULL;
+		boolReset(_replay.skip);
+	} else {
+		_replay.interface=replayInterface(name);
+		if(_replay.interface==NULL) {
+			boolSet(_replay.skip);
+		} else {
+			boolReset(_replay.skip);
+		}
+	}
+}
+
+/* Did we see this name before? Then it's a name and no data, no matter how
+ * much it looks like data. */
+static int replayNameKnown(char *line) {
+	int index;
+	for(index=0;index<_replay.mapCount;index++) {
+		if(strcmp(_replay.map[index].name,line)==0) {
+			return(1);
+		}
+	}
+	return(0);
+}
+
+/* Wait until the given moment of the capture has come. */
+static void replayWait(long long time) {
+	if(boolIsSet(_replay.timed)&&(_jpnevulatorOptions.replaySpeed>0.0)) {
+		long long gap;
+		gap=max(0LL,time-_replay.previous);
+		paceWaitNanoseconds((long long)(gap/_jpnevulatorOptions.replaySpeed));
+	}
+	boolSet(_replay.timed);
+	_replay.previous=time;
+}
+
+static void replayDestroy(char *line) {
+	int index;
+	for(index=0;index<_replay.mapCount;index++) {
+		free(_replay.map[index].name);
+	}
+	free(_replay.map);
+	_replay.map=NULL;
+	_replay.mapCount=0;
+	free(_replay.data);
+	_replay.data=NULL;
+	free(line);
+}
+
+/* Replay the capture in the given input. Every piece of data is handed to the
+ * given send call-back, together with the interface it goes out on (NULL for
+ * all of them). That one also adds the amount of bytes sent to the given
+ * counter. */
+enum replayRtrn replayRun(FILE *input,void (*send)(struct interface *,unsigned char *,int,int,unsigned long *),unsigned long *bytesSent) {
+	char *line=NULL;
+	size_t lineSize=0;
+	ssize_t length;
+	int lineNumber;
+	memset(&_replay,0,sizeof(_replay));
+	for(lineNumber=1;(_jpnevulatorOptions.count!=0)&&((length=getline(&line,&lineSize,input))!=-1);lineNumber++) {
+		long long time;
+		char *name;
+		int size;
+		/* Get rid of the end of the line. */
+		while((length>0)&&((line[length-1]=='\n')||(line[length-1]=='\r'))) {
+			line[--length]='\0';
+		}
+		if(length==0) {
+			continue;
+		}
+		/* Every byte takes at least one character, so this is always enough. */
+		if(_replay.dataSize<length) {
+			free(_replay.data);
+			if((_replay.data=(unsigned char *)malloc(length))==NULL) {
+				replayDestroy(line);
+				return(replayRtrnMemory);
+			}
+			_replay.dataSize=length;
+		}
+		if(replayHeader(line,&time,&name)) {
+			replayWait(time);
+			replaySwitch(name);
+			continue;
+		}
+		if(strncmp(line,"le=",3)==0) {
+			continue;
+		}
+		if(replayNameKnown(line)||((size=replayData(line))<0)) {
+			/* The tabs are gone by now, but a name has got none. */
+			replaySwitch(line);
+			continue;
+		}
+		if(boolIsSet(_replay.skip)) {
+			continue;
+		}
+		/* Do we count the amount of bytes to write? */
+		if(_jpnevulatorOptions.count>0) {
+			size=min(size,_jpnevulatorOptions.count);
+			_jpnevulatorOptions.count-=size;
+		}
+		send(_replay.interface,_replay.data,size,lineNumber,bytesSent);
+	}
+	replayDestroy(line);
+	return(replayRtrnOk);
+}
@@ -0,0 +1,77 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+
+#include "ring.h"
+
+/* Initialize the ring with room for at least the given amount of slots, each
+ * one of the given size. The amount of slots is rounded up to a power of two,
+ * so we can wrap our indexes around with a simple mask. */
+enum ringRtrn ringInitialize(struct ring *ring,unsigned int slots,size_t slotSize) {
+	unsigned int size;
+	for(size=1;size<slots;size<<=1);
+	/* Keep every slot nicely aligned, whatever the user puts in there. */
+	slotSize=(slotSize+15)&~((size_t)15);
+	ring->slots=(unsigned char *)malloc(size*slotSize);
+	if(ring->slots==NULL) {
+		return(ringRtrnMemory);
+	}
+	ring->slotSize=slotSize;
+	ring->mask=size-1;
+	atomic_init(&ring->head,0);
+	atomic_init(&ring->tail,0);
+	return(ringRtrnOk);
+}
+
+/* Get the next free slot for the producer or NULL if the ring is full. The slot
+ * only becomes visible to the consumer after a call to ringProduce(). */
+void *ringProduceGet(struct ring *ring) {
+	unsigned int head,tail;
+	head=atomic_load_explicit(&ring->head,memory_order_relaxed);
+	tail=atomic_load_explicit(&ring->tail,memory_order_acquire);
+	if((head-tail)>ring->mask) {
+		return(NULL);
+	}
+	return(ring->slots+((head&ring->mask)*ring->slotSize));
+}
+
+void ringProduce(struct ring *ring) {
+	atomic_store_explicit(&ring->head,atomic_load_explicit(&ring->head,memory_order_relaxed)+1,memory_order_release);
+}
+
+/* Get the oldest filled slot for the consumer or NULL if the ring is empty. The
+ * slot stays valid until the consumer hands it back with ringConsume(). */
+void *ringConsumeGet(struct ring *ring) {
+	unsigned int head,tail;
+	tail=atomic_load_explicit(&ring->tail,memory_order_relaxed);
+	head=atomic_load_explicit(&ring->head,memory_order_acquire);
+	if(head==tail) {
+		return(NULL);
+	}
+	return(ring->slots+((tail&ring->mask)*ring->slotSize));
+}
+
+void ringConsume(struct ring *ring) {
+	atomic_store_explicit(&ring->tail,atomic_load_explicit(&ring->tail,memory_order_relaxed)+1,memory_order_release);
+}
+
+void ringDestroy(struct ring *ring) {
+	free(ring->slots);
+	ring->slots=NULL;
+}
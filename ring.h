@@ -0,0 +1,48 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __RING_H
+#define __RING_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+/* A single-producer/single-consumer ring of fixed size slots. The producer
+ * and the consumer never take a lock, they only look at each others index.
+ * Both indexes live on their own cache line so they don't fight over it. */
+struct ring {
+	unsigned char *slots;
+	size_t slotSize;
+	unsigned int mask;
+	_Alignas(64) atomic_uint head;
+	_Alignas(64) atomic_uint tail;
+};
+
+enum ringRtrn {
+	ringRtrnOk=0,
+	ringRtrnMemory
+};
+
+extern enum ringRtrn ringInitialize(struct ring *,unsigned int,size_t);
+extern void *ringProduceGet(struct ring *);
+extern void ringProduce(struct ring *);
+extern void *ringConsumeGet(struct ring *);
+extern void ringConsume(struct ring *);
+extern void ringDestroy(struct ring *);
+
+#endif
@@ -0,0 +1,229 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/ioctl.h>
+/* We need termios2 to be able to set any speed, not only the ones with a Bxxx
+ * constant. It's the kernel's version of termios and clashes with the one of
+ * <termios.h>, so this is the only file that gets to know about it. */
+#include <asm/termbits.h>
+#include <linux/serial.h>
+
+#include "jpnevulator.h"
+#include "serial.h"
+
+/* Parse the settings for a tty, a comma separated list, much like stty:
+ *
+ *   115200        the speed, any speed the hardware supports
+ *   8n1           data bits (5-8), parity (n, e or o) and stop bits (1 or 2)
+ *   raw           no line editing, no echo, no translations, just bytes
+ *   rtscts        hardware flow control
+ *   xonxoff       software flow control
+ *   noflow        no flow control at all
+ *   vmin=n        the minimal amount of bytes a read waits for
+ *   vtime=n       the amount of tenths of a second a read waits for more
+ *   latency       return every byte as soon as it arrives (vmin=1, vtime=0)
+ *   throughput    wait a little for more bytes to arrive (vmin=255, vtime=1)
+ *   low-latency   ask the serial driver not to hold back received bytes */
+enum serialRtrn serialParse(struct serialSettings *settings,const char *specification) {
+	char *copy,*token,*save;
+	enum serialRtrn rtrn;
+
+	/* Start out with keeping everything the way it is. */
+	memset(settings,0,sizeof(*settings));
+	settings->vmin=-1;
+	settings->vtime=-1;
+	settings->flow=serialFlowKeep;
+
+	if((copy=strdup(specification))==NULL) {
+		return(serialRtrnInvalid);
+	}
+	rtrn=serialRtrnOk;
+	for(token=strtok_r(copy,",",&save);(token!=NULL)&&(rtrn==serialRtrnOk);token=strtok_r(NULL,",",&save)) {
+		if(isdigit((unsigned char)token[0])&&(strlen(token)==3)&&!isdigit((unsigned char)token[1])) {
+			settings->data=token[0]-'0';
+			settings->parity=tolower((unsigned char)token[1]);
+			settings->stop=token[2]-'0';
+			if(
+				(settings->data<5)||(settings->data>8)||
+				(strchr("neo",settings->parity)==NULL)||
+				((settings->stop!=1)&&(settings->stop!=2))
+			) {
+				rtrn=serialRtrnInvalid;
+			}
+		} else if(isdigit((unsigned char)token[0])) {
+			settings->speed=strtoul(token,NULL,10);
+			if(settings->speed==0) {
+				rtrn=serialRtrnInvalid;
+			}
+		} else if(strcasecmp(token,"raw")==0) {
+			boolSet(settings->raw);
+		} else if(strcasecmp(token,"rtscts")==0) {
+			settings->flow=serialFlowHardware;
+		} else if(strcasecmp(token,"xonxoff")==0) {
+			settings->flow=serialFlowSoftware;
+		} else if(strcasecmp(token,"noflow")==0) {
+			settings->flow=serialFlowNone;
+		} else if(strncasecmp(token,"vmin=",5)==0) {
+			settings->vmin=atoi(token+5);
+			if((settings->vmin<0)||(settings->vmin>255)) {
+				rtrn=serialRtrnInvalid;
+			}
+		} else if(strncasecmp(token,"vtime=",6)==0) {
+			settings->vtime=atoi(token+6);
+			if((settings->vtime<0)||(settings->vtime>255)) {
+				rtrn=serialRtrnInvalid;
+			}
+		} else if(strcasecmp(token,"latency")==0) {
+			settings->vmin=1;
+			settings->vtime=0;
+		} else if(strcasecmp(token,"throughput")==0) {
+			settings->vmin=255;
+			settings->vtime=1;
+		} else if(strcasecmp(token,"low-latency")==0) {
+			boolSet(settings->lowLatency);
+		} else {
+			rtrn=serialRtrnInvalid;
+		}
+	}
+	free(copy);
+	if(rtrn==serialRtrnOk) {
+		boolSet(settings->given);
+	}
+	return(rtrn);
+}
+
+/* Put the given settings in place. All termios settings are set at once, so
+ * the tty never runs with only half of them. The low latency flag is no part
+ * of termios, so it's set right before. Not every serial driver knows about
+ * it, so we only complain if it's not there. */
+enum serialRtrn serialApply(int fd,struct serialSettings *settings) {
+	struct termios2 termios;
+	if(boolIsNotSet(settings->given)) {
+		return(serialRtrnOk);
+	}
+	if(ioctl(fd,TCGETS2,&termios)) {
+		return(serialRtrnGet);
+	}
+	if(boolIsSet(settings->lowLatency)) {
+		struct serial_struct serial;
+		int rtrn;
+		rtrn=ioctl(fd,TIOCGSERIAL,&serial);
+		if((rtrn==0)&&!(serial.flags&ASYNC_LOW_LATENCY)) {
+			serial.flags|=ASYNC_LOW_LATENCY;
+			rtrn=ioctl(fd,TIOCSSERIAL,&serial);
+		}
+		if(rtrn!=0) {
+			fprintf(stderr,"%s: Unable to put the serial driver in low latency mode, ignoring.\n",PROGRAM_NAME);
+		}
+	}
+	/* Just like cfmakeraw() does. */
+	if(boolIsSet(settings->raw)) {
+		termios.c_iflag&=~(IGNBRK|BRKINT|PARMRK|ISTRIP|INLCR|IGNCR|ICRNL|IXON);
+		termios.c_oflag&=~OPOST;
+		termios.c_lflag&=~(ECHO|ECHONL|ICANON|ISIG|IEXTEN);
+		termios.c_cflag&=~(CSIZE|PARENB);
+		termios.c_cflag|=CS8;
+		termios.c_cc[VMIN]=1;
+		termios.c_cc[VTIME]=0;
+	}
+	/* Any speed is set the same way, the kernel finds out itself if it's one of
+	 * the well known ones. */
+	if(settings->speed>0) {
+		termios.c_cflag&=~(CBAUD|(CBAUD<<IBSHIFT));
+		termios.c_cflag|=BOTHER|(BOTHER<<IBSHIFT);
+		termios.c_ispeed=settings->speed;
+		termios.c_ospeed=settings->speed;
+	}
+	if(settings->data>0) {
+		static const tcflag_t sizes[]={CS5,CS6,CS7,CS8};
+		termios.c_cflag&=~(CSIZE|PARENB|PARODD|CSTOPB);
+		termios.c_cflag|=sizes[settings->data-5];
+		if(settings->parity!='n') {
+			termios.c_cflag|=PARENB|(settings->parity=='o'?PARODD:0);
+		}
+		if(settings->stop==2) {
+			termios.c_cflag|=CSTOPB;
+		}
+	}
+	switch(settings->flow) {
+		case serialFlowNone: {
+			termios.c_cflag&=~CRTSCTS;
+			termios.c_iflag&=~(IXON|IXOFF|IXANY);
+			break;
+		}
+		case serialFlowHardware: {
+			termios.c_cflag|=CRTSCTS;
+			termios.c_iflag&=~(IXON|IXOFF|IXANY);
+			break;
+		}
+		case serialFlowSoftware: {
+			termios.c_cflag&=~CRTSCTS;
+			termios.c_iflag|=IXON|IXOFF;
+			break;
+		}
+		case serialFlowKeep:
+		default: {
+			break;
+		}
+	}
+	if(settings->vmin>=0) {
+		termios.c_cc[VMIN]=settings->vmin;
+	}
+	if(settings->vtime>=0) {
+		termios.c_cc[VTIME]=settings->vtime;
+	}
+	/* We own this line from now on, don't let a missing carrier get in the way. */
+	termios.c_cflag|=CLOCAL|CREAD;
+	if(ioctl(fd,TCSETS2,&termios)) {
+		return(serialRtrnSet);
+	}
+	return(serialRtrnOk);
+}
+
+/* The amount of nanoseconds it takes to put one character on the wire, given
+ * the speed and character format the tty is set to. A character is a start bit,
+ * the data bits, an optional parity bit and one or two stop bits. The kernel
+ * always tells the real speed in termios2, no matter how it was set. Returns 0
+ * if the given file descriptor is no tty or we don't know its speed. A pty
+ * happily tells a speed as well, 38400 baud most of the time, but nothing ever
+ * goes over a wire there. So only trust the speed of a real UART, which is
+ * something that answers TIOCGSERIAL with a known port type. */
+long long serialCharacterTime(int fd) {
+	struct termios2 termios;
+	struct serial_struct serial;
+	int bits;
+	if(ioctl(fd,TIOCGSERIAL,&serial)||(serial.type==PORT_UNKNOWN)) {
+		return(0LL);
+	}
+	if(ioctl(fd,TCGETS2,&termios)||(termios.c_ospeed==0)) {
+		return(0LL);
+	}
+	switch(termios.c_cflag&CSIZE) {
+		case CS5: bits=5; break;
+		case CS6: bits=6; break;
+		case CS7: bits=7; break;
+		case CS8:
+		default: bits=8; break;
+	}
+	bits+=1+(termios.c_cflag&PARENB?1:0)+(termios.c_cflag&CSTOPB?2:1);
+	return(((long long)bits*1000000000LL)/termios.c_ospeed);
+}
@@ -0,0 +1,57 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __SERIAL_H
+#define __SERIAL_H
+
+#include "misc.h"
+
+enum serialFlow {
+	serialFlowKeep=0,
+	serialFlowNone,
+	serialFlowHardware,
+	serialFlowSoftware
+};
+
+/* The way a tty should be set up once opened. Anything not given (zero, -1
+ * for vmin and vtime or serialFlowKeep) is left the way it was. */
+struct serialSettings {
+	bool_t given;
+	unsigned long speed;
+	int data;
+	char parity;
+	int stop;
+	enum serialFlow flow;
+	bool_t raw;
+	int vmin;
+	int vtime;
+	bool_t lowLatency;
+};
+
+enum serialRtrn {
+	serialRtrnOk=0,
+	serialRtrnInvalid,
+	serialRtrnGet,
+	serialRtrnSet
+};
+
+extern enum serialRtrn serialParse(struct serialSettings *,const char *);
+extern enum serialRtrn serialApply(int,struct serialSettings *);
+extern long long serialCharacterTime(int);
+
+#endif
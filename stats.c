@@ -0,0 +1,253 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "jpnevulator.h"
+#include "interface.h"
+#include "queue.h"
+#include "timestamp.h"
+#include "serial.h"
+#include "histogram.h"
+#include "stats.h"
+
+/* All the counters we keep, for the user to have a look at whenever he or she
+ * likes to. Send us a SIGUSR1 and we report, just like we do every so many
+ * seconds and at the end if asked to (--statistics). The report is meant to
+ * be read by programs as much as by humans: a line for all of us together and
+ * one for every interface, each filled with key=value pairs. The gaps seen
+ * on every interface are kept in a histogram, which can be written to a file
+ * of its own as a whole (--histogram). */
+struct stats _stats;
+volatile sig_atomic_t _statsPending=0;
+
+/* Becomes readable once a report is asked for, so whoever waits for something
+ * else can wait for this one too (see statsFd()). */
+static int _statsFd=-1;
+
+/* A signal can come in at any moment, so all we do is tell the main loop. The
+ * flag is cheap to look at while busy, the eventfd wakes it up while waiting. */
+static void statsSignal(int signal) {
+	uint64_t one=1;
+	int error;
+	error=errno;
+	_statsPending=1;
+	if(write(_statsFd,&one,sizeof(one))<0) {
+		/* Nothing we can do about it, the flag is up anyway. */
+	}
+	errno=error;
+}
+
+/* Keep our signals away from the calling thread, so they always end up with
+ * the main loop. To be called by every thread we start. */
+void statsSignalsBlock(void) {
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals,SIGUSR1);
+	sigaddset(&signals,SIGALRM);
+	pthread_sigmask(SIG_BLOCK,&signals,NULL);
+}
+
+int statsFd(void) {
+	return(_statsFd);
+}
+
+/* Called once our eventfd became readable. */
+void statsNotified(void *data) {
+	eventfd_t value;
+	eventfd_read(_statsFd,&value);
+	statsPoll(stderr);
+}
+
+enum statsRtrn statsInitialize(void) {
+	struct sigaction action;
+	int id;
+	memset(&_stats,0,sizeof(_stats));
+	_statsPending=0;
+	_stats.interface=(struct statsInterface *)calloc(max(1,interfaceCount()),sizeof(struct statsInterface));
+	if(_stats.interface==NULL) {
+		return(statsRtrnMemory);
+	}
+	/* To tell the quiet time between bytes we need to know how long it takes
+	 * a byte to come in. No tty, no time, so than it's all quiet time. */
+	for(id=0;id<interfaceCount();id++) {
+		_stats.interface[id].characterTime=serialCharacterTime(interfaceGet(id)->fd);
+	}
+	timestampGet(&_stats.start);
+	_statsFd=eventfd(0,EFD_CLOEXEC|EFD_NONBLOCK);
+	if(_statsFd==-1) {
+		return(statsRtrnSignal);
+	}
+	/* Don't let the signal break off any system call, whoever waits keeps an
+	 * eye on our eventfd instead. */
+	memset(&action,0,sizeof(action));
+	action.sa_handler=statsSignal;
+	action.sa_flags=SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if(sigaction(SIGUSR1,&action,NULL)!=0) {
+		return(statsRtrnSignal);
+	}
+	if(boolIsSet(_jpnevulatorOptions.statistics)&&(_jpnevulatorOptions.statisticsInterval>0)) {
+		struct itimerval timer;
+		if(sigaction(SIGALRM,&action,NULL)!=0) {
+			return(statsRtrnSignal);
+		}
+		timer.it_interval.tv_sec=_jpnevulatorOptions.statisticsInterval;
+		timer.it_interval.tv_usec=0;
+		timer.it_value=timer.it_interval;
+		if(setitimer(ITIMER_REAL,&timer,NULL)!=0) {
+			return(statsRtrnSignal);
+		}
+	}
+	return(statsRtrnOk);
+}
+
+/* A chunk of bytes has been read at the given time. The kernel hands it to us
+ * once the last byte is in, so the first one started to come in as long ago as
+ * it takes to put all of them on the wire. What's left of the time since the
+ * previous chunk is how long the line was quiet. That's the only quiet time we
+ * really measure, so it's all that goes in the byte gap histogram. The bytes
+ * within a chunk came in one after the other as far as we can tell, but making
+ * up a gap of 0 for every one of them would only drown the real ones. They are
+ * simply counted. */
+void statsGap(struct statsInterface *stats,struct timestamp *timeRead,ssize_t bytesRead) {
+	long long gap,quiet;
+	if(bytesRead<=0) {
+		return;
+	}
+	if(boolIsSet(stats->seen)) {
+		gap=max(0LL,timestampDiff(timeRead,&stats->last));
+		quiet=max(0LL,gap-(stats->characterTime*bytesRead));
+		histogramAdd(&stats->chunkGap,(unsigned long long)gap,1ULL);
+		histogramAdd(&stats->byteGap,(unsigned long long)quiet,1ULL);
+	}
+	stats->backToBack+=bytesRead-1;
+	boolSet(stats->seen);
+	stats->last=*timeRead;
+}
+
+/* A percentile summary of one of our histograms. */
+static void statsGapReport(FILE *output,struct interface *interface,char *name,struct histogram *histogram) {
+	if(histogram->count==0) {
+		return;
+	}
+	fprintf(
+		output,
+		"%s: stats interface=%s gap=%s count=%llu min_ns=%llu p50_ns=%llu p90_ns=%llu p99_ns=%llu p999_ns=%llu max_ns=%llu\n",
+		PROGRAM_NAME,interfacePrint(interface),name,histogram->count,histogram->min,
+		histogramPercentile(histogram,50.0),histogramPercentile(histogram,90.0),
+		histogramPercentile(histogram,99.0),histogramPercentile(histogram,99.9),
+		histogram->max
+	);
+}
+
+void statsReport(FILE *output) {
+	struct timestamp now;
+	int id;
+	if(_stats.interface==NULL) {
+		return;
+	}
+	timestampGet(&now);
+	fprintf(
+		output,
+		"%s: stats elapsed=%.6f wakeups=%llu chunks=%llu format_ns=%lld messages=%llu\n",
+		PROGRAM_NAME,(double)timestampDiff(&now,&_stats.start)/1e9,
+		_stats.wakeups,_stats.chunks,_stats.formatTime,_stats.messages
+	);
+	for(id=0;id<interfaceCount();id++) {
+		struct interface *interface;
+		struct statsInterface *stats;
+		interface=interfaceGet(id);
+		stats=&_stats.interface[id];
+		fprintf(
+			output,
+			"%s: stats interface=%s read_bytes=%llu reads=%llu bytes_per_read=%.1f back_to_back=%llu written_bytes=%llu writes=%llu write_errors=%llu dropped=%llu\n",
+			PROGRAM_NAME,interfacePrint(interface),
+			stats->readBytes,stats->reads,stats->reads>0?(double)stats->readBytes/stats->reads:0.0,stats->backToBack,
+			stats->writtenBytes,stats->writes,stats->writeErrors,
+			interface->queue!=NULL?interface->queue->dropped:0ULL
+		);
+		statsGapReport(output,interface,"chunk",&stats->chunkGap);
+		statsGapReport(output,interface,"byte",&stats->byteGap);
+	}
+	fflush(output);
+}
+
+/* All buckets of one of our histograms that have something in them. */
+static void statsGapExport(FILE *output,struct interface *interface,char *name,struct histogram *histogram) {
+	int bucket;
+	for(bucket=0;bucket<HISTOGRAM_BUCKETS;bucket++) {
+		if(histogram->bucket[bucket]>0) {
+			fprintf(
+				output,"%s %s %llu %llu %llu\n",
+				interfacePrint(interface),name,
+				histogramBucketLow(bucket),histogramBucketHigh(bucket),histogram->bucket[bucket]
+			);
+		}
+	}
+}
+
+/* Write our histograms as a whole to the file given (--histogram). We start
+ * all over every time, so the file always holds what we know right now. One
+ * line for every bucket, ready to be plotted or fed to any other program. */
+void statsExport(void) {
+	FILE *output;
+	int id;
+	if((_stats.interface==NULL)||(_jpnevulatorOptions.histogram==NULL)) {
+		return;
+	}
+	output=fopen(_jpnevulatorOptions.histogram,"w");
+	if(output==NULL) {
+		char error[1024];
+		snprintf(error,sizeof(error)-1,"%s: Unable to write the histograms to %s",PROGRAM_NAME,_jpnevulatorOptions.histogram);
+		perror(error);
+		return;
+	}
+	fprintf(output,"# interface gap low_ns high_ns count\n");
+	for(id=0;id<interfaceCount();id++) {
+		statsGapExport(output,interfaceGet(id),"chunk",&_stats.interface[id].chunkGap);
+		statsGapExport(output,interfaceGet(id),"byte",&_stats.interface[id].byteGap);
+	}
+	fclose(output);
+}
+
+void statsDestroy(void) {
+	if(boolIsSet(_jpnevulatorOptions.statistics)&&(_jpnevulatorOptions.statisticsInterval>0)) {
+		struct itimerval timer;
+		memset(&timer,0,sizeof(timer));
+		setitimer(ITIMER_REAL,&timer,NULL);
+		signal(SIGALRM,SIG_DFL);
+	}
+	signal(SIGUSR1,SIG_DFL);
+	if(_statsFd!=-1) {
+		close(_statsFd);
+		_statsFd=-1;
+	}
+	if(_stats.interface!=NULL) {
+		free(_stats.interface);
+		_stats.interface=NULL;
+	}
+}
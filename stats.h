@@ -0,0 +1,105 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef __STATS_H
+#define __STATS_H
+
+#include <stdio.h>
+#include <signal.h>
+#include <sys/types.h>
+
+#include "interface.h"
+#include "timestamp.h"
+#include "histogram.h"
+#include "misc.h"
+
+/* What happened on every interface... */
+struct statsInterface {
+	unsigned long long readBytes;
+	unsigned long long reads;
+	unsigned long long writtenBytes;
+	unsigned long long writes;
+	unsigned long long writeErrors;
+	/* How long it was quiet between two chunks read, from the start of the
+	 * one to the start of the other, and on the wire right before a chunk.
+	 * Within a chunk we can't tell, we only count the bytes that came in
+	 * right after another one. */
+	bool_t seen;
+	struct timestamp last;
+	long long characterTime;
+	struct histogram chunkGap;
+	struct histogram byteGap;
+	unsigned long long backToBack;
+};
+
+/* ...and what happened in general. */
+struct stats {
+	struct timestamp start;
+	unsigned long long wakeups;
+	unsigned long long chunks;
+	unsigned long long messages;
+	long long formatTime;
+	struct statsInterface *interface;
+};
+
+enum statsRtrn {
+	statsRtrnOk=0,
+	statsRtrnMemory,
+	statsRtrnSignal
+};
+
+extern struct stats _stats;
+extern volatile sig_atomic_t _statsPending;
+
+/* Counting is nothing more than an addition, so it's done right where it
+ * happens. Only the main thread counts, so no need for any locking. */
+#define statsRead(x,t,n) { \
+	if(_stats.interface!=NULL) { \
+		_stats.interface[(x)->id].reads++; \
+		_stats.interface[(x)->id].readBytes+=(n); \
+		statsGap(&_stats.interface[(x)->id],(t),(n)); \
+	} \
+}
+#define statsWrite(x,n) { \
+	if(_stats.interface!=NULL) { \
+		if((n)<0) { \
+			_stats.interface[(x)->id].writeErrors++; \
+		} else { \
+			_stats.interface[(x)->id].writes++; \
+			_stats.interface[(x)->id].writtenBytes+=(n); \
+		} \
+	} \
+}
+/* Somebody asked for a report? */
+#define statsPoll(x) { \
+	if(_statsPending) { \
+		_statsPending=0; \
+		statsReport(x); \
+		statsExport(); \
+	} \
+}
+
+extern enum statsRtrn statsInitialize(void);
+extern void statsSignalsBlock(void);
+extern int statsFd(void);
+extern void statsNotified(void *);
+extern void statsGap(struct statsInterface *,struct timestamp *,ssize_t);
+extern void statsReport(FILE *);
+extern void statsExport(void);
+extern void statsDestroy(void);
+
+#endif
@@ -0,0 +1,110 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "timestamp.h"
+#include "misc.h"
+
+static struct {
+	enum timestampStyle style;
+	/* The last timestamp formatted, the delta style counts from here. */
+	struct timestamp previous;
+	/* The "YYYY-MM-DD HH:MM:SS" part of the timestamp only changes once a
+	 * second, so we only let localtime() and friends do their expensive
+	 * work once a second. */
+	time_t second;
+	bool_t secondValid;
+	char prefix[TIMESTAMP_LENGTH];
+	int prefixLength;
+} _timestamp;
+
+/* Start formatting in the given style. The delta style counts the first
+ * timestamp from the given start or from this very moment if none given. */
+void timestampInitialize(enum timestampStyle style,struct timestamp *start) {
+	_timestamp.style=style;
+	boolReset(_timestamp.secondValid);
+	if(start!=NULL) {
+		_timestamp.previous=*start;
+	} else {
+		timestampGet(&_timestamp.previous);
+	}
+}
+
+void timestampGet(struct timestamp *timestamp) {
+	clock_gettime(CLOCK_MONOTONIC,&timestamp->monotonic);
+	clock_gettime(CLOCK_REALTIME,&timestamp->realtime);
+}
+
+/* The amount of nanoseconds from earlier to later, on the monotonic clock. */
+long long timestampDiff(struct timestamp *later,struct timestamp *earlier) {
+	return(
+		((long long)(later->monotonic.tv_sec-earlier->monotonic.tv_sec)*1000000000LL)+
+		later->monotonic.tv_nsec-earlier->monotonic.tv_nsec
+	);
+}
+
+/* Put the given value as exactly digits decimal digits at the given place. */
+static void timestampDigits(char *buffer,long value,int digits) {
+	for(;digits>0;digits--) {
+		buffer[digits-1]='0'+(value%10);
+		value/=10;
+	}
+}
+
+/* Format the timestamp the way the user wants it to see. The result is not
+ * NUL terminated, the length of it is returned. */
+int timestampFormat(struct timestamp *timestamp,char *buffer) {
+	int length;
+	if(_timestamp.style==timestampStyleDelta) {
+		long long delta;
+		delta=timestampDiff(timestamp,&_timestamp.previous);
+		_timestamp.previous=*timestamp;
+		if(delta<0) {
+			delta=0;
+		}
+		length=sprintf(buffer,"+%lld.",delta/1000000000LL);
+		timestampDigits(&(buffer[length]),(delta%1000000000LL)/1000L,6);
+		return(length+6);
+	}
+	_timestamp.previous=*timestamp;
+	if(boolIsNotSet(_timestamp.secondValid)||(_timestamp.second!=timestamp->realtime.tv_sec)) {
+		struct tm time;
+		localtime_r(&(timestamp->realtime.tv_sec),&time);
+		_timestamp.prefixLength=sprintf(
+			_timestamp.prefix,
+			"%04d-%02d-%02d %02d:%02d:%02d.",
+			time.tm_year+1900,time.tm_mon+1,time.tm_mday,
+			time.tm_hour,time.tm_min,time.tm_sec
+		);
+		_timestamp.second=timestamp->realtime.tv_sec;
+		boolSet(_timestamp.secondValid);
+	}
+	memcpy(buffer,_timestamp.prefix,_timestamp.prefixLength);
+	length=_timestamp.prefixLength;
+	if(_timestamp.style==timestampStyleNano) {
+		timestampDigits(&(buffer[length]),timestamp->realtime.tv_nsec,9);
+		length+=9;
+	} else {
+		timestampDigits(&(buffer[length]),timestamp->realtime.tv_nsec/1000L,6);
+		length+=6;
+	}
+	return(length);
+}
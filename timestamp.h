@@ -0,0 +1,47 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __TIMESTAMP_H
+#define __TIMESTAMP_H
+
+#include <time.h>
+
+/* A moment in time, taken from two clocks. The monotonic one is used for
+ * everything that measures time between two moments, that way a wall clock
+ * jump (NTP, the user, ...) doesn't make a gap appear or disappear. The
+ * realtime one is only used to tell the user what time it was. */
+struct timestamp {
+	struct timespec monotonic;
+	struct timespec realtime;
+};
+
+enum timestampStyle {
+	timestampStyleMicro=0,
+	timestampStyleNano,
+	timestampStyleDelta
+};
+
+/* Enough room for the longest timestamp we ever format. */
+#define TIMESTAMP_LENGTH 64
+
+extern void timestampInitialize(enum timestampStyle,struct timestamp *);
+extern void timestampGet(struct timestamp *);
+extern long long timestampDiff(struct timestamp *,struct timestamp *);
+extern int timestampFormat(struct timestamp *,char *);
+
+#endif
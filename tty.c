@@ -22,13 +22,23 @@
 #include <fcntl.h>
 #include <termios.h>
 #include <sys/ioctl.h>
+#include <linux/serial.h>
 
 #include "jpnevulator.h"
 #include "interface.h"
+#include "serial.h"
 #include "tty.h"
 
-static int ttyOpen(char *name,int length) {
-	return(open(name,O_RDWR));
+/* Open the tty and put the settings the user gave us in place, if any. */
+static int ttyOpen(char **name) {
+	int fd;
+	fd=open(*name,O_RDWR);
+	if((fd!=-1)&&(serialApply(fd,&_jpnevulatorOptions.serial)!=serialRtrnOk)) {
+		fprintf(stderr,"%s: Unable to apply the serial settings to %s.\n",PROGRAM_NAME,*name);
+		close(fd);
+		fd=-1;
+	}
+	return(fd);
 }
 
 static int ttyControlGet(int fd,char *name) {
@@ -42,7 +52,7 @@ static int ttyControlGet(int fd,char *name) {
 	return control;
 }
 
-static void ttyControlWrite(FILE *output,int control) {
+void ttyControlWrite(FILE *output,int control) {
 	fprintf(
 		output,
 		"le=%d, dtr=%d, rts=%d, st=%d, sr=%d, cts=%d, cd=%d, ri=%d, dsr=%d\n",
@@ -58,10 +68,62 @@ static void ttyControlWrite(FILE *output,int control) {
 	);
 }
 
+/* A line that changed an even amount of times since we last looked is back where
+ * it was. It did change though, so let the caller know. */
+#define ttyControlPulse(now,last,bit) ((((now)!=(last))&&((((now)-(last))&1)==0))?(bit):0)
+
+/* Wait for any of the modem input lines to change. The kernel counts every change,
+ * so we first check if something already changed since the last time we looked and
+ * only wait if not. That way no change slips through while we were away. Returns
+ * the lines that changed and changed back again or -1 if we can't wait. */
+static int ttyControlWait(int fd,struct interfaceControlCount *count) {
+	struct serial_icounter_struct icount;
+	int pulsed;
+	if(ioctl(fd,TIOCGICOUNT,&icount)) {
+		return(-1);
+	}
+	if(boolIsNotSet(count->valid)) {
+		count->cts=icount.cts;
+		count->dsr=icount.dsr;
+		count->ri=icount.rng;
+		count->cd=icount.dcd;
+		boolSet(count->valid);
+	}
+	if((icount.cts==count->cts)&&(icount.dsr==count->dsr)&&(icount.rng==count->ri)&&(icount.dcd==count->cd)) {
+		if(ioctl(fd,TIOCMIWAIT,TIOCM_CTS|TIOCM_DSR|TIOCM_RNG|TIOCM_CD)) {
+			return(-1);
+		}
+		if(ioctl(fd,TIOCGICOUNT,&icount)) {
+			return(-1);
+		}
+	}
+	pulsed=ttyControlPulse(icount.cts,count->cts,TIOCM_CTS)|
+		ttyControlPulse(icount.dsr,count->dsr,TIOCM_DSR)|
+		ttyControlPulse(icount.rng,count->ri,TIOCM_RNG)|
+		ttyControlPulse(icount.dcd,count->cd,TIOCM_CD);
+	count->cts=icount.cts;
+	count->dsr=icount.dsr;
+	count->ri=icount.rng;
+	count->cd=icount.dcd;
+	return(pulsed);
+}
+
 static void ttyClose(int fd) {
 	close(fd);
 }
 
 enum interfaceRtrn ttyAdd(char *name) {
-	return(interfaceAdd(name,ttyOpen,ttyControlGet,ttyControlWrite,ttyClose));
+	struct serial_icounter_struct icount;
+	struct interface *interface;
+	enum interfaceRtrn rtrn;
+	rtrn=interfaceAdd(name,ttyOpen,ttyControlGet,ttyControlWrite,ttyClose);
+	if(rtrn==interfaceRtrnOk) {
+		/* Only a tty that counts the changes of its modem input lines is able to
+		 * wait for them too. */
+		interface=interfaceGet(interfaceCount()-1);
+		if(ioctl(interface->fd,TIOCGICOUNT,&icount)==0) {
+			interface->controlWait=ttyControlWait;
+		}
+	}
+	return(rtrn);
 }
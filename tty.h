@@ -19,6 +19,9 @@
 #ifndef __TTY_H
 #define __TTY_H
 
+#include <stdio.h>
+
 extern enum interfaceRtrn ttyAdd(char *);
+extern void ttyControlWrite(FILE *,int);
 
 #endif
@@ -0,0 +1,281 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+#include "jpnevulator.h"
+#include "interface.h"
+#include "serial.h"
+#include "queue.h"
+#include "timestamp.h"
+#include "pace.h"
+#include "writer.h"
+
+/* Every interface we write to has a writer of its own. All writers get the
+ * same message at the same time and the pacing (--delay-byte, see pace.c) is
+ * applied once for all of them, not once per interface. Since writing to an
+ * interface never waits for it (see queue.c), one byte goes out on all
+ * interfaces before we sleep. That way ten interfaces take just as long as one
+ * and they stay in step. Meanwhile we keep track of how far every writer lags
+ * behind the first one, which is what we call the skew.
+ *
+ * If the user likes us to (--wire) we also take the time every character
+ * needs on the wire into account, so we never write faster than the slowest
+ * interface is able to send. */
+struct writer {
+	struct interface *interface;
+	unsigned long writes;
+	long long lagTotal;
+	long long lagMax;
+	long long characterTime;
+};
+
+/* The amount of characters a tty may still have to send once we think it
+ * should be done, before we wait for it. Covers the FIFO of most UARTs. */
+#define WRITER_WIRE_SLACK 16
+
+static struct writer *_writers=NULL;
+static int _writersCount=0;
+
+/* Without any delay between them there is no need to write the messages one
+ * by one. If the user likes us to (--batch) they are gathered here and go out
+ * together, in one write per interface. We remember the line the batch
+ * started with, so errors still point somewhere near. And the size of every
+ * message in there, so they can be printed once they are sent, not before. A
+ * batch only waits for more messages as long as they are ready, see
+ * writerFlush(). */
+static struct {
+	unsigned char *data;
+	int *sizes;
+	int size;
+	int length;
+	int lines;
+	int line;
+} _batch;
+
+/* Prints a message once it's sent, if the user likes to see them. */
+static void (*_print)(unsigned char *,int)=NULL;
+
+enum writerRtrn writerInitialize(void (*print)(unsigned char *,int)) {
+	struct interface *interface;
+	int id;
+	_writersCount=0;
+	_print=print;
+	_batch.data=NULL;
+	_batch.sizes=NULL;
+	_batch.length=0;
+	_batch.lines=0;
+	/* A replay keeps the timing of its capture, so nothing is held back then. */
+	if(
+		(_jpnevulatorOptions.batchSize>0)&&(_jpnevulatorOptions.delayLine==0)&&(_jpnevulatorOptions.delayByte==0)&&
+		boolIsNotSet(_jpnevulatorOptions.replay)
+	) {
+		_batch.size=_jpnevulatorOptions.batchSize;
+		_batch.data=(unsigned char *)malloc(sizeof(_batch.data[0])*_batch.size);
+		_batch.sizes=(int *)malloc(sizeof(_batch.sizes[0])*_batch.size);
+		if((_batch.data==NULL)||(_batch.sizes==NULL)) {
+			return(writerRtrnMemory);
+		}
+	}
+	_writers=(struct writer *)calloc(interfaceCount(),sizeof(struct writer));
+	if(_writers==NULL) {
+		return(writerRtrnMemory);
+	}
+	for(id=0;id<interfaceCount();id++) {
+		interface=interfaceGet(id);
+		_writers[_writersCount].interface=interface;
+		/* Only a tty knows how long a character takes. A slower rate
+		 * means more time per character. */
+		if(_jpnevulatorOptions.wireRate>0) {
+			_writers[_writersCount].characterTime=(serialCharacterTime(interface->fd)*100LL)/_jpnevulatorOptions.wireRate;
+		}
+		_writersCount++;
+	}
+	return(writerRtrnOk);
+}
+
+/* Hand the given bytes to all the writers, or only the one of the given
+ * interface, one after the other, and see how long it took every one of them
+ * after the first one was done. The first one is the reference, so it never
+ * lags. Returns the amount of nanoseconds the slowest interface needs to put
+ * the bytes on the wire. */
+static long long writerRound(struct interface *interface,unsigned char *data,int size,int line,int byteIndex) {
+	struct timestamp first,done;
+	long long wire;
+	int index;
+	wire=0LL;
+	/* Whatever an interface could not take the previous round goes first. */
+	queueFlush();
+	for(index=0;index<_writersCount;index++) {
+		struct writer *writer;
+		ssize_t n;
+		writer=&_writers[index];
+		if((interface!=NULL)&&(writer->interface!=interface)) {
+			continue;
+		}
+		n=queueWrite(writer->interface,data,size);
+		if(n<0) {
+			if(byteIndex<0) {
+				fprintf(stderr,"%s: %s: write of line %d failed(%d).\n",PROGRAM_NAME,interfacePrint(writer->interface),line,(int)n);
+			} else {
+				fprintf(stderr,"%s: %s: write of line %d byte %d failed(%d).\n",PROGRAM_NAME,interfacePrint(writer->interface),line,byteIndex,(int)n);
+			}
+		}
+		if((index==0)||(interface!=NULL)) {
+			timestampGet(&first);
+		} else {
+			long long lag;
+			timestampGet(&done);
+			lag=timestampDiff(&done,&first);
+			writer->lagTotal+=lag;
+			writer->lagMax=max(writer->lagMax,lag);
+		}
+		writer->writes++;
+		wire=max(wire,writer->characterTime*size);
+	}
+	return(wire);
+}
+
+/* Wait for the bytes of the last round to be on the wire. If a tty still has
+ * more than a few characters to send after that, it's slower than we think
+ * (flow control, a speed we don't know of, ...) so let it catch up. */
+static void writerWire(long long wire) {
+	int index;
+	if(wire==0LL) {
+		return;
+	}
+	paceWaitNanoseconds(wire);
+	for(index=0;index<_writersCount;index++) {
+		int pending;
+		if(
+			(_writers[index].characterTime>0LL)&&
+			(ioctl(_writers[index].interface->fd,TIOCOUTQ,&pending)==0)&&
+			(pending>WRITER_WIRE_SLACK)
+		) {
+			tcdrain(_writers[index].interface->fd);
+		}
+	}
+}
+
+/* Send a message on the given interface or on all interfaces if none given,
+ * byte by byte if the user likes us to delay between them. */
+void writerSend(struct interface *interface,unsigned char *message,int size,int line) {
+	if(_jpnevulatorOptions.delayByte>0) {
+		int byteIndex;
+		for(byteIndex=0;byteIndex<size;byteIndex++) {
+			writerWire(writerRound(interface,&(message[byteIndex]),1,line,byteIndex));
+			paceWait(_jpnevulatorOptions.delayByte);
+		}
+	} else {
+		writerWire(writerRound(interface,message,size,line,-1));
+	}
+}
+
+/* Send whatever messages are gathered so far and print them. Called whenever
+ * there is no other message ready to join them, so none of them waits for a
+ * message that might take a while to come. */
+void writerFlush(void) {
+	if(_batch.lines>0) {
+		writerSend(NULL,_batch.data,_batch.length,_batch.line);
+		if(_print!=NULL) {
+			int line,start;
+			for(start=0,line=0;line<_batch.lines;start+=_batch.sizes[line],line++) {
+				_print(&(_batch.data[start]),_batch.sizes[line]);
+			}
+		}
+		_batch.length=0;
+		_batch.lines=0;
+	}
+}
+
+/* Send a message on all interfaces and print it, or add it to the batch if
+ * we're batching. A message that doesn't fit anymore flushes the batch first
+ * and one that's bigger than the batch as a whole is sent on its own. */
+void writerBatch(unsigned char *message,int size,int line) {
+	if((_batch.data!=NULL)&&((_batch.length+size)>_batch.size)) {
+		writerFlush();
+	}
+	if((_batch.data==NULL)||(size>_batch.size)) {
+		writerSend(NULL,message,size,line);
+		if(_print!=NULL) {
+			_print(message,size);
+		}
+		return;
+	}
+	if(_batch.lines==0) {
+		_batch.line=line;
+	}
+	memcpy(&(_batch.data[_batch.length]),message,size);
+	_batch.sizes[_batch.lines++]=size;
+	_batch.length+=size;
+	if((_batch.length==_batch.size)||(_batch.lines==_batch.size)||(_batch.lines==_jpnevulatorOptions.batchLines)) {
+		writerFlush();
+	}
+}
+
+/* Wait until all ttys are done sending, if we care about the wire at all. */
+void writerDrain(void) {
+	int index;
+	for(index=0;index<_writersCount;index++) {
+		if(_writers[index].characterTime>0LL) {
+			tcdrain(_writers[index].interface->fd);
+		}
+	}
+}
+
+/* Tell how far the interfaces drifted apart. Only interesting if there is more
+ * than one of them and the user asked us to take our time. */
+void writerReport(FILE *output) {
+	int index;
+	if((_writersCount<2)||((_jpnevulatorOptions.delayByte==0)&&(_jpnevulatorOptions.delayLine==0))) {
+		return;
+	}
+	for(index=1;index<_writersCount;index++) {
+		struct writer *writer;
+		writer=&_writers[index];
+		if(writer->writes>0) {
+			fprintf(
+				output,
+				"%s: %s: %lu writes, lagging %lldus on average and %lldus at most behind %s.\n",
+				PROGRAM_NAME,interfacePrint(writer->interface),writer->writes,
+				(writer->lagTotal/(long long)writer->writes)/1000LL,writer->lagMax/1000LL,
+				interfacePrint(_writers[0].interface)
+			);
+		}
+	}
+}
+
+void writerDestroy(void) {
+	if(_batch.data!=NULL) {
+		free(_batch.data);
+		_batch.data=NULL;
+	}
+	if(_batch.sizes!=NULL) {
+		free(_batch.sizes);
+		_batch.sizes=NULL;
+	}
+	if(_writers!=NULL) {
+		free(_writers);
+		_writers=NULL;
+	}
+	_writersCount=0;
+}
@@ -0,0 +1,39 @@
+/* jpnevulator - serial reader/writer
+ * Copyright (C) 2006-2020 Freddy Spierenburg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __WRITER_H
+#define __WRITER_H
+
+#include <stdio.h>
+
+#include "interface.h"
+
+enum writerRtrn {
+	writerRtrnOk=0,
+	writerRtrnMemory
+};
+
+extern enum writerRtrn writerInitialize(void (*)(unsigned char *,int));
+extern void writerSend(struct interface *,unsigned char *,int,int);
+extern void writerBatch(unsigned char *,int,int);
+extern void writerFlush(void);
+extern void writerDrain(void);
+extern void writerReport(FILE *);
+extern void writerDestroy(void);
+
+#endif